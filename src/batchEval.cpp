@@ -0,0 +1,45 @@
+/* Copyright 2021 DucaPowr Team */
+#include "./batchEval.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "./moveGen.h"
+
+static void evalChunk(const CompactPosition *positions, size_t count,
+        int *scores) {
+    Board board;
+    board.init();
+    Generator generator(board);
+
+    for (size_t i = 0; i < count; i++) {
+        board.setPosition(positions[i]);
+
+        // Fill in the attack cache, like the search does before its leaves
+        generator.getAttackBB(whiteSide);
+        generator.getAttackBB(blackSide);
+
+        scores[i] = board.eval();
+    }
+}
+
+void evalBatch(const CompactPosition *positions, size_t count, int *scores,
+        unsigned int threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    size_t chunk = (count + threads - 1) / threads;
+    std::vector<std::thread> workers;
+
+    for (size_t start = 0; start < count; start += chunk) {
+        size_t len = std::min(chunk, count - start);
+        workers.emplace_back(evalChunk, positions + start, len,
+            scores + start);
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
@@ -0,0 +1,21 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include <stddef.h>
+
+#include "./board.h"
+
+/**
+ * @brief Evaluates a batch of positions with Board::eval(), including the
+ * king danger terms, so the scores match the ones seen by the search.
+ * The positions are split in contiguous chunks across threads, and every
+ * thread reuses a single Board and Generator for its whole chunk.
+ *
+ * @param positions the positions to evaluate
+ * @param count the number of positions
+ * @param scores receives the score of each position, from the point of view
+ * of its side to move
+ * @param threads the number of threads to use, 0 for all hardware threads
+ */
+void evalBatch(const CompactPosition *positions, size_t count, int *scores,
+        unsigned int threads);
@@ -0,0 +1,18 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include <ostream>
+
+/**
+ * Searches a fixed set of positions (middlegames, endgames and positions
+ * with plenty of checks) and prints the node count, the time and the speed.
+ * The total node count is a signature of the search: it only changes when
+ * the search or the eval changes. It is run with the hand-crafted eval and
+ * without the endgame tables, whatever the working directory holds.
+ *
+ * @param depth the depth of every search, in plies
+ * @param threads the number of threads, 0 for all hardware threads. The
+ * positions are spread over the threads, so the node count does not
+ * depend on it.
+ */
+void runBench(int depth, unsigned int threads, std::ostream& out);
@@ -2,15 +2,47 @@
 #include "./board.h"
 
 #include <bits/stdint-uintn.h>
+#include <algorithm>
+#include <cctype>
 #include <csetjmp>
+#include <cstdlib>
 #include <string>
 #include <sys/types.h>
 #include <random>
 
 #include "./constants.h"
+#include "./evalParams.h"
 #include "./logger.h"
 #include "./utils.h"
 
+U64 Board::pieceHashKeys[64][12];
+U64 Board::flagHashKeys[20];
+U64 Board::checkHashKeys[64][2];
+U64 Board::blackToMoveHashKey;
+
+bool Board::initHashKeys(void) {
+    std::uniform_int_distribution<unsigned long long int>
+                                 dist(0, UINT64_MAX);
+    std::mt19937 mt(1234567);
+    for (uint16_t i = 0; i < 64; i++) {
+        for (uint16_t j = 0; j < 12; j++) {
+            pieceHashKeys[i][j] = dist(mt);
+        }
+    }
+    for (uint16_t i = 0; i < 20; i++) {
+        flagHashKeys[i] = dist(mt);
+    }
+    for (uint16_t i = 0; i < 64; i++) {
+        checkHashKeys[i][0] = dist(mt);
+        checkHashKeys[i][1] = dist(mt);
+    }
+
+    blackToMoveHashKey = dist(mt);
+    return true;
+}
+
+bool Board::hashKeysReady = Board::initHashKeys();
+
 void Board::init(void) {
     pieceBB[nWhitePawn] = WHITEPAWNSTART;
     pieceBB[nBlackPawn] = BLACKPAWNSTART;
@@ -36,24 +68,299 @@ void Board::init(void) {
     checkCount[0] = 0;
     checkCount[1] = 0;
 
-    std::uniform_int_distribution<unsigned long long int>
-                                 dist(0, UINT64_MAX);
-    std::mt19937 mt(1234567);
-    for (uint16_t i = 0; i < 64; i++) {
-        for (uint16_t j = 0; j < 12; j++) {
-            pieceHashKeys[i][j] = dist(mt);
+    startFullmove = 1;
+    startSide = whiteSide;
+
+    attackCache[whiteSide].valid = false;
+    attackCache[blackSide].valid = false;
+
+    accumulators.clear();
+    if (Network::isLoaded()) {
+        accumulators.resize(1);
+        Network::refresh(accumulators.back(), pieceBB, checkCount);
+    }
+
+}
+
+void Board::setPosition(const CompactPosition& pos) {
+    memcpy(pieceBB, pos.pieceBB, sizeof(pos.pieceBB));
+    pieceBB[trashPiece] = 0;
+    pieceBB[trashPieceBlack] = 0;
+
+    sideToMove = (Side) pos.sideToMove;
+    flags = 0;
+
+    // Avoid reallocating the stacks when they are already empty
+    if (!moveHistory.empty()) {
+        moveHistory  = std::stack<uint16_t>();
+        takeHistory  = std::stack<enum enumPiece>();
+        flagsHistory = std::stack<U64>();
+    }
+
+    checkCount[0] = pos.checkCount[0];
+    checkCount[1] = pos.checkCount[1];
+
+    startFullmove = 1;
+    startSide = sideToMove;
+
+    attackCache[whiteSide].valid = false;
+    attackCache[blackSide].valid = false;
+
+    if (Network::isLoaded()) {
+        accumulators.resize(1);
+        Network::refresh(accumulators.back(), pieceBB, checkCount);
+    }
+}
+
+void Board::getPosition(CompactPosition *pos) {
+    memcpy(pos->pieceBB, pieceBB, sizeof(pos->pieceBB));
+    pos->checkCount[0] = checkCount[0];
+    pos->checkCount[1] = checkCount[1];
+    pos->sideToMove = sideToMove;
+}
+
+// Maps a FEN piece letter to its enumPiece index, or -1
+static int pieceIndexFromFEN(char c) {
+    switch (c) {
+    case 'P': return nWhitePawn;
+    case 'p': return nBlackPawn;
+    case 'B': return nWhiteBishop;
+    case 'b': return nBlackBishop;
+    case 'N': return nWhiteKnight;
+    case 'n': return nBlackKnight;
+    case 'R': return nWhiteRook;
+    case 'r': return nBlackRook;
+    case 'Q': return nWhiteQueen;
+    case 'q': return nBlackQueen;
+    case 'K': return nWhiteKing;
+    case 'k': return nBlackKing;
+    default: return -1;
+    }
+}
+
+bool Board::setFromFEN(const std::string& fen) {
+    CompactPosition pos;
+    memset(&pos, 0, sizeof(pos));
+
+    // Piece placement, from rank 8 to rank 1
+    size_t i = 0;
+    int rank = 7, file = 0;
+    for (; i < fen.size() && fen[i] != ' '; i++) {
+        char c = fen[i];
+
+        if (c == '/') {
+            if (file != 8 || --rank < 0) {
+                return false;
+            }
+            file = 0;
+        } else if (c >= '1' && c <= '8') {
+            file += c - '0';
+            if (file > 8) {
+                return false;
+            }
+        } else {
+            int piece = pieceIndexFromFEN(c);
+            if (piece < 0 || file > 7) {
+                return false;
+            }
+            pos.pieceBB[piece] |= 1ULL << (rank * 8 + file);
+            file++;
         }
     }
-    for (uint16_t i = 0; i < 20; i++) {
-        flagHashKeys[i] = dist(mt);
+
+    // Every rank covers the 8 files
+    if (rank != 0 || file != 8) {
+        return false;
     }
-    for (uint16_t i = 0; i < 64; i++) {
-        checkHashKeys[i][0] = dist(mt);
-        checkHashKeys[i][1] = dist(mt);
+
+    // One king a side, and no pawn on the first or last rank
+    if (__builtin_popcountll(pos.pieceBB[nWhiteKing]) != 1 ||
+            __builtin_popcountll(pos.pieceBB[nBlackKing]) != 1 ||
+            ((pos.pieceBB[nWhitePawn] | pos.pieceBB[nBlackPawn]) &
+            (RANK1 | RANK8))) {
+        return false;
     }
 
+    // Side to move
+    if (++i >= fen.size()) {
+        return false;
+    }
+    if (fen[i] == 'w') {
+        pos.sideToMove = whiteSide;
+    } else if (fen[i] == 'b') {
+        pos.sideToMove = blackSide;
+    } else {
+        return false;
+    }
+    if (++i >= fen.size() || fen[i] != ' ') {
+        return false;
+    }
+    i++;
+
+    // Castling rights
+    U64 newFlags = 0;
+    for (; i < fen.size() && fen[i] != ' '; i++) {
+        switch (fen[i]) {
+        case 'K': newFlags |= WHITEKINGSIDECASTLE; break;
+        case 'Q': newFlags |= WHITEQUEENSIDECASTLE; break;
+        case 'k': newFlags |= BLACKKINGSIDECASTLE; break;
+        case 'q': newFlags |= BLACKQUEENSIDECASTLE; break;
+        case '-': break;
+        default: return false;
+        }
+    }
+    i++;
+
+    // The king and the rook of every right on their starting squares
+    const U64 whiteKing = pos.pieceBB[nWhiteKing] & (1ULL << 4);
+    const U64 blackKing = pos.pieceBB[nBlackKing] & (1ULL << 60);
+    if (((newFlags & WHITEKINGSIDECASTLE) &&
+            !(whiteKing && (pos.pieceBB[nWhiteRook] & (1ULL << 7)))) ||
+            ((newFlags & WHITEQUEENSIDECASTLE) &&
+            !(whiteKing && (pos.pieceBB[nWhiteRook] & (1ULL << 0)))) ||
+            ((newFlags & BLACKKINGSIDECASTLE) &&
+            !(blackKing && (pos.pieceBB[nBlackRook] & (1ULL << 63)))) ||
+            ((newFlags & BLACKQUEENSIDECASTLE) &&
+            !(blackKing && (pos.pieceBB[nBlackRook] & (1ULL << 56))))) {
+        return false;
+    }
+
+    /**
+     * En passant target square. The flags store the pawn that jumped
+     * instead: the target is on rank 3 after a white jump and on rank 6
+     * after a black one.
+    */
+    if (i + 1 < fen.size() && fen[i] != '-') {
+        int epFile = fen[i] - 'a';
+        if (epFile < 0 || epFile > 7 ||
+                (fen[i + 1] != '3' && fen[i + 1] != '6')) {
+            return false;
+        }
+        Side jumped = (fen[i + 1] == '3' ? whiteSide : blackSide);
+        newFlags |= (1ULL << epFile) << (jumped << 3);
+    }
+    while (i < fen.size() && fen[i] != ' ') {
+        i++;
+    }
+
+    // Optional fields: check counters, halfmove clock, fullmove number
+    int halfmove = 0, fullmove = 1, numbers = 0;
+    while (i < fen.size()) {
+        for (; i < fen.size() && fen[i] == ' '; i++) {
+        }
+        size_t start = i;
+        for (; i < fen.size() && fen[i] != ' '; i++) {
+        }
+        if (start == i) {
+            break;
+        }
+
+        size_t plus = fen.find('+', start);
+        if (plus < i) {
+            // "+N+M" counts the checks given, "N+M" the checks left
+            bool given = plus == start;
+            size_t first = given ? start + 1 : start;
+            size_t second = fen.find('+', first);
+            if (second + 2 != i || first + 1 != second ||
+                    !isdigit(fen[first]) || !isdigit(fen[second + 1])) {
+                return false;
+            }
+
+            int white = fen[first] - '0', black = fen[second + 1] - '0';
+            if (!given) {
+                white = 3 - white;
+                black = 3 - black;
+            }
+            if (white < 0 || white > 3 || black < 0 || black > 3) {
+                return false;
+            }
+
+            // The checks given by white are received by the black king
+            pos.checkCount[whiteSide] = black;
+            pos.checkCount[blackSide] = white;
+        } else if (++numbers == 1) {
+            halfmove = atoi(fen.c_str() + start);
+        } else if (numbers == 2) {
+            fullmove = atoi(fen.c_str() + start);
+        }
+    }
+
+    setPosition(pos);
+    flags = newFlags |
+        (static_cast<U64>(std::max(halfmove, 0)) << FLAGS_HALFMOVE_SHIFT);
+    startFullmove = fullmove > 0 ? fullmove : 1;
+
+    return true;
+}
+
+std::string Board::toFEN(void) {
+    // Indexed by enumPiece
+    static char const pieceSymbol[12] = {'P', 'p', 'B', 'b', 'N', 'n',
+        'R', 'r', 'Q', 'q', 'K', 'k'};
+    char board[64] = {0};
+
+    for (int i = 0; i < 12; i++) {
+        for (U64 bb = pieceBB[i]; bb; bb &= bb - 1) {
+            board[__builtin_ctzll(bb)] = pieceSymbol[i];
+        }
+    }
+
+    std::string fen;
+    fen.reserve(96);
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            char c = board[rank * 8 + file];
+            if (!c) {
+                empty++;
+                continue;
+            }
+            if (empty) {
+                fen += '0' + empty;
+                empty = 0;
+            }
+            fen += c;
+        }
+        if (empty) {
+            fen += '0' + empty;
+        }
+        fen += rank ? '/' : ' ';
+    }
+
+    fen += sideToMove == whiteSide ? "w " : "b ";
+
+    size_t castling = fen.size();
+    if (flags & WHITEKINGSIDECASTLE) fen += 'K';
+    if (flags & WHITEQUEENSIDECASTLE) fen += 'Q';
+    if (flags & BLACKKINGSIDECASTLE) fen += 'k';
+    if (flags & BLACKQUEENSIDECASTLE) fen += 'q';
+    if (fen.size() == castling) {
+        fen += '-';
+    }
+
+    // The square behind the pawn that just jumped
+    U64 jumped = flags & 0xffff;
+    if (jumped) {
+        int bit = __builtin_ctzll(jumped);
+        fen += ' ';
+        fen += 'a' + (bit & 7);
+        fen += bit < 8 ? '3' : '6';
+    } else {
+        fen += " -";
+    }
+
+    int fullmove = startFullmove +
+        (static_cast<int>(moveHistory.size()) + startSide) / 2;
+    fen += ' ' + std::to_string(flags >> FLAGS_HALFMOVE_SHIFT) + ' ' +
+        std::to_string(fullmove);
+
+    fen += " +" + std::to_string(checkCount[blackSide]) +
+        '+' + std::to_string(checkCount[whiteSide]);
+
+    return fen;
 }
 
+
 #pragma region Bitboard getters
 U64 Board::getPieceBB(Side side) {
     U64 *BB = this->pieceBB;
@@ -199,33 +506,24 @@ uint16_t Board::convertSanToMove(std::string move) {
  * a promotion is marked.
  */
 std::string Board::convertMoveToSan(uint16_t move) {
-    std::string res;
-    res.push_back((move & 7) + 'a');
-    res.push_back(((move >> 3) & 7) + '1');
-    res.push_back(((move >> 6) & 7) + 'a');
-    res.push_back(((move >> 9) & 7) + '1');
+    char res[5];
+    return std::string(res, writeMove(move, res));
+}
+
+int Board::writeMove(uint16_t move, char *out) {
+    // Indexed by the promotion bits
+    static char const promotionSymbol[4] = {'r', 'n', 'b', 'q'};
+
+    out[0] = (move & 7) + 'a';
+    out[1] = ((move >> 3) & 7) + '1';
+    out[2] = ((move >> 6) & 7) + 'a';
+    out[3] = ((move >> 9) & 7) + '1';
 
     if ((move >> 14) == 1) {
-        char prom;
-        switch ((move & 0x3000) >> 12) {
-            case 0:
-                prom = 'r';
-                break;
-            case 1:
-                prom = 'n';
-                break;
-            case 2:
-                prom = 'b';
-                break;
-            case 3:
-                prom = 'q';
-                break;
-            default:
-                break;
-        }
-        res.push_back(prom);
+        out[4] = promotionSymbol[(move & 0x3000) >> 12];
+        return 5;
     }
-    return res;
+    return 4;
 }
 
 #pragma endregion
@@ -622,7 +920,38 @@ void Board::resetCastleFlags(enum enumPiece movedPieceIndex,
     }
 }
 
+const Accumulator& Board::getAccumulator(void) {
+    return accumulators.back();
+}
+
+void Board::updateAccumulator(const U64 *oldPieceBB) {
+    accumulators.push_back(accumulators.back());
+    Accumulator& acc = accumulators.back();
+
+    // Diffing the bitboards covers captures, promotions, castling and en
+    // passant alike.
+    for (int i = 0; i < 12; i++) {
+        U64 changed = oldPieceBB[i] ^ pieceBB[i];
+        U64 removed = changed & oldPieceBB[i];
+        U64 added = changed & pieceBB[i];
+
+        while (removed) {
+            Network::removePiece(acc, i, getSquareIndex(removed));
+            removed &= removed - 1;
+        }
+        while (added) {
+            Network::addPiece(acc, i, getSquareIndex(added));
+            added &= added - 1;
+        }
+    }
+}
+
 bool Board::applyMove(uint16_t move) {
+    U64 oldPieceBB[12];
+    if (Network::isLoaded()) {
+        memcpy(oldPieceBB, pieceBB, sizeof(oldPieceBB));
+    }
+
     flagsHistory.push(flags);
 
     enPassantAttackPrep(move);
@@ -663,8 +992,23 @@ bool Board::applyMove(uint16_t move) {
     resetCastleFlags(sourceSquareIndex, sourcePosBoard,
             destSquareIndex, destPosBoard);
 
+    // The halfmove clock starts again after a capture or a pawn move
+    if (destSquareIndex != trashPiece ||
+            (sourceSquareIndex >> 1) == (nWhitePawn >> 1)) {
+        flags &= ~FLAGS_HALFMOVE_MASK;
+    } else {
+        flags += 1ULL << FLAGS_HALFMOVE_SHIFT;
+    }
+
     switchSide();
 
+    attackCache[whiteSide].valid = false;
+    attackCache[blackSide].valid = false;
+
+    if (Network::isLoaded()) {
+        updateAccumulator(oldPieceBB);
+    }
+
     // TODO(all) change later with move legality.
     return true;
 }
@@ -718,198 +1062,58 @@ bool Board::undoMove(void) {
     flagsHistory.pop();
     takeHistory.pop();
 
+    attackCache[whiteSide].valid = false;
+    attackCache[blackSide].valid = false;
+
+    if (Network::isLoaded()) {
+        accumulators.pop_back();
+    }
+
     return true;
 }
 
 void Board::updateCheckCounter(uint8_t x, Side side) {
+    uint8_t oldCount = checkCount[side];
     checkCount[side] += x;
+
+    if (Network::isLoaded()) {
+        Network::updateChecks(accumulators.back(), side, oldCount,
+            checkCount[side]);
+    }
+}
+
+
+int Board::kingDanger(Side attacker) {
+    AttackCache &atk = attackCache[attacker];
+    const EvalParams& p = evalParams;
+
+    int danger = 0;
+    danger += p.knightCheckValue * bitCount(atk.knight & atk.knightChecks);
+    danger += p.bishopCheckValue * bitCount(atk.bishop & atk.bishopChecks);
+    danger += p.rookCheckValue * bitCount(atk.rook & atk.rookChecks);
+    danger += p.queenCheckValue * bitCount(atk.queen &
+            (atk.bishopChecks | atk.rookChecks));
+    danger += p.kingZoneAttackValue * bitCount(atk.all & atk.kingZone);
+
+    // Every check counts in 3-check, so the closer the defender is to its
+    // third check, the more dangerous these squares get.
+    return danger * (1 + checkCount[otherSide(attacker)]);
 }
 
+// Interpolates between the middle game and the end game scores
+static int taperedScore(int score_mg, int score_eg, int phase) {
+    return ((score_mg * (256 - phase)) + (score_eg * phase)) / 256;
+}
 
 // BOARD EVAL
-int Board::eval() {
+int Board::eval(int alpha, int beta) {
+    const EvalParams& p = evalParams;
     int score_mg = 0;
     int score_eg = 0;
 
     Side me = sideToMove;
     Side them = otherSide(sideToMove);
 
-    // PIECES
-    // mg
-    score_mg += bitCount(getPawnBB(me))        * PawnValueMg;
-    score_mg -= bitCount(getPawnBB(them))      * PawnValueMg;
-    score_mg += bitCount(getKnightBB(me))      * KnightValueMg;
-    score_mg -= bitCount(getKnightBB(them))    * KnightValueMg;
-    score_mg += bitCount(getBishopBB(me))      * BishopValueMg;
-    score_mg -= bitCount(getBishopBB(them))    * BishopValueMg;
-    score_mg += bitCount(getRookBB(me))        * RookValueMg;
-    score_mg -= bitCount(getRookBB(them))      * RookValueMg;
-    score_mg += bitCount(getQueenBB(me))       * QueenValueMg;
-    score_mg -= bitCount(getQueenBB(them))     * QueenValueMg;
-    // eg
-    score_eg += bitCount(getPawnBB(me))        * PawnValueEg;
-    score_eg -= bitCount(getPawnBB(them))      * PawnValueEg;
-    score_eg += bitCount(getKnightBB(me))      * KnightValueEg;
-    score_eg -= bitCount(getKnightBB(them))    * KnightValueEg;
-    score_eg += bitCount(getBishopBB(me))      * BishopValueEg;
-    score_eg -= bitCount(getBishopBB(them))    * BishopValueEg;
-    score_eg += bitCount(getRookBB(me))        * RookValueEg;
-    score_eg -= bitCount(getRookBB(them))      * RookValueEg;
-    score_eg += bitCount(getQueenBB(me))       * QueenValueEg;
-    score_eg -= bitCount(getQueenBB(them))     * QueenValueEg;
-
-    // PIECE POSITIONING
-    
-    // U64 pieceBBCpy[14];
-    // memcpy(pieceBBCpy, pieceBB, 14 * sizeof(U64));
-    // unsigned int position, otherSideOffset, mySideOffset, pieceBBIndex;
-    // mySideOffset = (me == Side::whiteSide ? 0 : 1);
-    // otherSideOffset = (them == Side::whiteSide ? -1 : 0);
-
-    // pieceBBIndex = nWhitePawn + mySideOffset;
-    // while (pieceBBCpy[pieceBBIndex]) {
-    //     position = getSquareIndex(pieceBBCpy[pieceBBIndex]);
-
-    //     score_mg += mg_pawn_table[position];
-    //     score_eg += eg_pawn_table[position];
-
-    //     pieceBBCpy[pieceBBIndex] ^= (1LL << position);
-    // }
-
-    // pieceBBIndex = nBlackPawn + otherSideOffset;
-    // while (pieceBBCpy[pieceBBIndex]) {
-    //     position = getSquareIndex(pieceBBCpy[pieceBBIndex]);
-
-    //     score_mg -= mg_pawn_table[position];
-    //     score_eg -= eg_pawn_table[position];
-
-    //     pieceBBCpy[pieceBBIndex] ^= (1LL << position);
-    // }
-
-    // pieceBBIndex = nWhiteRook + mySideOffset;
-    // while (pieceBBCpy[pieceBBIndex]) {
-    //     position = getSquareIndex(pieceBBCpy[pieceBBIndex]);
-
-    //     score_mg += mg_rook_table[position];
-    //     score_eg += eg_rook_table[position];
-
-    //     pieceBBCpy[pieceBBIndex] ^= (1LL << position);
-    // }
-
-    // pieceBBIndex = nBlackRook + otherSideOffset;
-    // while (pieceBBCpy[pieceBBIndex]) {
-    //     position = getSquareIndex(pieceBBCpy[pieceBBIndex]);
-
-    //     score_mg -= mg_rook_table[position];
-    //     score_eg -= eg_rook_table[position];
-
-
-    //     pieceBBCpy[pieceBBIndex] ^= (1LL << position);
-    // }
-
-    // pieceBBIndex = nWhiteBishop + mySideOffset;
-    // while (pieceBBCpy[pieceBBIndex]) {
-    //     position = getSquareIndex(pieceBBCpy[pieceBBIndex]);
-
-    //     score_mg += mg_bishop_table[position];
-    //     score_eg += eg_bishop_table[position];
-
-    //     pieceBBCpy[pieceBBIndex] ^= (1LL << position);
-    // }
-
-    // pieceBBIndex = nBlackBishop + otherSideOffset;
-    // while (pieceBBCpy[pieceBBIndex]) {
-    //     position = getSquareIndex(pieceBBCpy[pieceBBIndex]);
-
-    //     score_mg -= mg_bishop_table[position];
-    //     score_eg -= eg_bishop_table[position];
-
-    //     pieceBBCpy[pieceBBIndex] ^= (1LL << position);
-    // }
-
-    // pieceBBIndex = nWhiteKnight + mySideOffset;
-    // while (pieceBBCpy[pieceBBIndex]) {
-    //     position = getSquareIndex(pieceBBCpy[pieceBBIndex]);
-
-    //     score_mg += mg_knight_table[position];
-    //     score_eg += eg_knight_table[position];
-
-    //     pieceBBCpy[pieceBBIndex] ^= (1LL << position);
-    // }
-
-    // pieceBBIndex = nBlackKnight + otherSideOffset;
-    // while (pieceBBCpy[pieceBBIndex]) {
-    //     position = getSquareIndex(pieceBBCpy[pieceBBIndex]);
-
-    //     score_mg -= mg_knight_table[position];
-    //     score_eg -= eg_knight_table[position];
-
-
-    //     pieceBBCpy[pieceBBIndex] ^= (1LL << position);
-    // }
-
-    // pieceBBIndex = nWhiteQueen + mySideOffset;
-    // while (pieceBBCpy[pieceBBIndex]) {
-    //     position = getSquareIndex(pieceBBCpy[pieceBBIndex]);
-
-    //     score_mg += mg_queen_table[position];
-    //     score_eg += eg_queen_table[position];
-
-    //     pieceBBCpy[pieceBBIndex] ^= (1LL << position);
-    // }
-
-    // pieceBBIndex = nBlackQueen + otherSideOffset;
-    // while (pieceBBCpy[pieceBBIndex]) {
-    //     position = getSquareIndex(pieceBBCpy[pieceBBIndex]);
-
-    //     score_mg -= mg_queen_table[position];
-    //     score_eg -= eg_queen_table[position];
-
-    //     pieceBBCpy[pieceBBIndex] ^= (1LL << position);
-    // }
-
-    // pieceBBIndex = nWhiteKing + mySideOffset;
-    // while (pieceBBCpy[pieceBBIndex]) {
-    //     position = getSquareIndex(pieceBBCpy[pieceBBIndex]);
-
-    //     score_mg += mg_king_table[position];
-    //     score_eg += eg_king_table[position];
-
-    //     pieceBBCpy[pieceBBIndex] ^= (1LL << position);
-    // }
-
-    // pieceBBIndex = nBlackKing + otherSideOffset;
-    // while (pieceBBCpy[pieceBBIndex]) {
-    //     position = getSquareIndex(pieceBBCpy[pieceBBIndex]);
-
-    //     score_mg -= mg_king_table[position];
-    //     score_eg -= eg_king_table[position];
-
-    //     pieceBBCpy[pieceBBIndex] ^= (1LL << position);
-    // }
-
-    // THREE CHECK RULE
-    // score += bishopPairWeight * ((bishopCount + 2) >> 2);
-
-    // Score high if king is near friend pieces
-    score_mg += KingFriendsValueMg * (bitCount(aKingsNeighbors(getKingBB(me)) &
-                getPieceBB(me)));
-    score_mg -= KingFriendsValueMg * (bitCount(aKingsNeighbors(getKingBB(them)) &
-                getPieceBB(them)));
-
-    score_eg += KingFriendsValueEg * (bitCount(aKingsNeighbors(getKingBB(me)) &
-                getPieceBB(me)));
-    score_eg -= KingFriendsValueEg * (bitCount(aKingsNeighbors(getKingBB(them)) &
-                getPieceBB(them)));
-
-    // Scoring that depends on number of checks
-    int my_check_score    = checkCount[me] * checkCount[me] * CheckCountValue;
-    int their_check_score = checkCount[them] * checkCount[them] * CheckCountValue;
-    score_mg += my_check_score;
-    score_mg -= their_check_score;
-    score_eg += my_check_score;
-    score_eg -= their_check_score;
-
     // 3 CHESS LOSE
     if (checkCount[me] >= 3) 
         return INT_MIN;
@@ -922,9 +1126,68 @@ int Board::eval() {
     if (!bitCount(getKingBB(them)))
         return INT_MAX;
 
+    // NEURAL NETWORK
+    if (Network::isLoaded()) {
+        return Network::evaluate(accumulators.back(), me);
+    }
+
+    // PIECES
+    // mg
+    score_mg += bitCount(getPawnBB(me))        * p.pawnValueMg;
+    score_mg -= bitCount(getPawnBB(them))      * p.pawnValueMg;
+    score_mg += bitCount(getKnightBB(me))      * p.knightValueMg;
+    score_mg -= bitCount(getKnightBB(them))    * p.knightValueMg;
+    score_mg += bitCount(getBishopBB(me))      * p.bishopValueMg;
+    score_mg -= bitCount(getBishopBB(them))    * p.bishopValueMg;
+    score_mg += bitCount(getRookBB(me))        * p.rookValueMg;
+    score_mg -= bitCount(getRookBB(them))      * p.rookValueMg;
+    score_mg += bitCount(getQueenBB(me))       * p.queenValueMg;
+    score_mg -= bitCount(getQueenBB(them))     * p.queenValueMg;
+    // eg
+    score_eg += bitCount(getPawnBB(me))        * p.pawnValueEg;
+    score_eg -= bitCount(getPawnBB(them))      * p.pawnValueEg;
+    score_eg += bitCount(getKnightBB(me))      * p.knightValueEg;
+    score_eg -= bitCount(getKnightBB(them))    * p.knightValueEg;
+    score_eg += bitCount(getBishopBB(me))      * p.bishopValueEg;
+    score_eg -= bitCount(getBishopBB(them))    * p.bishopValueEg;
+    score_eg += bitCount(getRookBB(me))        * p.rookValueEg;
+    score_eg -= bitCount(getRookBB(them))      * p.rookValueEg;
+    score_eg += bitCount(getQueenBB(me))       * p.queenValueEg;
+    score_eg -= bitCount(getQueenBB(them))     * p.queenValueEg;
+
+    // PIECE POSITIONING
+    // The tables are indexed from white's point of view, in the same order
+    // as enumPiece (without the colours).
+    for (int i = 0; i < 12; i++) {
+        U64 bb = pieceBB[i];
+        Side side = (Side) (i & 1);
+        // Black squares are mirrored vertically
+        int flip = (side == whiteSide ? 0 : 56);
+        int sign = (side == me ? 1 : -1);
+
+        while (bb) {
+            int position = getSquareIndex(bb) ^ flip;
+
+            score_mg += sign * p.mgTables[i >> 1][position];
+            score_eg += sign * p.egTables[i >> 1][position];
+
+            bb &= bb - 1;
+        }
+    }
+
+    // THREE CHECK RULE
+    // score += bishopPairWeight * ((bishopCount + 2) >> 2);
+
+    // Scoring that depends on number of checks received
+    int my_check_score    = checkCount[me] * checkCount[me] * p.checkCountValue;
+    int their_check_score = checkCount[them] * checkCount[them] * p.checkCountValue;
+    score_mg -= my_check_score;
+    score_mg += their_check_score;
+    score_eg -= my_check_score;
+    score_eg += their_check_score;
 
     // PHASE CALCULATION
-    uint16_t phase = TotalPhase;
+    int phase = TotalPhase;
 
     phase -= bitCount(getPawnBB(me)) * PawnPhase;
     phase -= bitCount(getPawnBB(them)) * PawnPhase;
@@ -937,27 +1200,72 @@ int Board::eval() {
     phase -= bitCount(getQueenBB(me)) * QueenPhase;
     phase -= bitCount(getQueenBB(them)) * QueenPhase;
 
+    // Promotions can bring more material than in the initial position
+    if (phase < 0) {
+        phase = 0;
+    }
+
     phase = (phase * 256 + 12) / TotalPhase;
 
-    return ((score_mg * (256 - phase)) + (score_eg * phase)) / 256;
+    // LAZY EVAL
+    // The king terms below are clamped to LazyEvalMargin, so they cannot
+    // bring a score that is this far outside the search window back into it.
+    int score = taperedScore(score_mg, score_eg, phase);
+    if (score + LazyEvalMargin <= alpha || score - LazyEvalMargin >= beta) {
+        return score;
+    }
+
+    int king_mg = 0;
+    int king_eg = 0;
+
+    // Score high if king is near friend pieces
+    king_mg += p.kingFriendsValueMg * (bitCount(aKingsNeighbors(getKingBB(me)) &
+                getPieceBB(me)));
+    king_mg -= p.kingFriendsValueMg * (bitCount(aKingsNeighbors(getKingBB(them)) &
+                getPieceBB(them)));
+
+    king_eg += p.kingFriendsValueEg * (bitCount(aKingsNeighbors(getKingBB(me)) &
+                getPieceBB(me)));
+    king_eg -= p.kingFriendsValueEg * (bitCount(aKingsNeighbors(getKingBB(them)) &
+                getPieceBB(them)));
+
+    // Score low if the enemy can check our king. Only done when the Generator
+    // has cached the attack maps of this position.
+    if (attackCache[me].valid && attackCache[them].valid) {
+        int my_danger    = kingDanger(them);
+        int their_danger = kingDanger(me);
+        king_mg -= my_danger;
+        king_mg += their_danger;
+        king_eg -= my_danger;
+        king_eg += their_danger;
+    }
+
+    // 8 friends at KingFriendsValueEg, or a danger multiplied by the checks
+    // received, go past the margin on their own
+    int king = taperedScore(king_mg, king_eg, phase);
+    king = std::max(-LazyEvalMargin, std::min(king, LazyEvalMargin));
+
+    return score + king;
 }
 
 U64 Board::hash() {
     U64 hash = 0;
     for (size_t i = 0; i < 12; i++) {
-        auto pieces = getSeparatedBits(pieceBB[i]);
-        for (U64 pieceBB : pieces) {
-            int sqIndex = getSquareIndex(pieceBB);
-
-            hash ^= pieceHashKeys[sqIndex][i];
+        U64 pieces = pieceBB[i];
+        while (pieces) {
+            hash ^= pieceHashKeys[getSquareIndex(pieces)][i];
+            pieces &= pieces - 1;
         }
     }
-    for (size_t i = 0; i < 20; i++) {
-        if (flags & (1 << i)) {
-            hash ^= flagHashKeys[i];
-        }
+    uint32_t setFlags = flags & 0xFFFFF;
+    while (setFlags) {
+        hash ^= flagHashKeys[__builtin_ctz(setFlags)];
+        setFlags &= setFlags - 1;
     }
     hash ^= checkHashKeys[checkCount[whiteSide]][whiteSide];
     hash ^= checkHashKeys[checkCount[blackSide]][blackSide];
+    if (sideToMove == blackSide) {
+        hash ^= blackToMoveHashKey;
+    }
     return hash;
 }
\ No newline at end of file
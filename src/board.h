@@ -8,8 +8,10 @@
 #include <iostream>
 #include <stack>
 #include <climits>
+#include <vector>
 
 #include "./logger.h"
+#include "./nnue.h"
 #include "./utils.h"
 
 enum enumPiece {
@@ -30,6 +32,40 @@ enum enumPiece {
     trashPieceBlack
 };
 
+/**
+ * Attack maps of one side, filled in by Generator::getAttackBB() and read by
+ * eval() for the king danger terms. They are invalidated by every
+ * applyMove()/undoMove().
+ */
+struct AttackCache {
+    bool valid;
+    // Squares attacked by each piece type of this side
+    U64 all;
+    U64 pawn;
+    U64 knight;
+    U64 bishop;
+    U64 rook;
+    U64 queen;
+    // The squares around the enemy king
+    U64 kingZone;
+    // Squares from which a knight/bishop/rook of this side would give check
+    // to the enemy king
+    U64 knightChecks;
+    U64 bishopChecks;
+    U64 rookChecks;
+};
+
+/**
+ * A position without any history, for bulk work (tuning, data sets).
+ * Castling and en passant rights are not stored.
+ */
+struct CompactPosition {
+    U64 pieceBB[12];
+    // Checks received by the white/black king, see Board::checkCount
+    uint8_t checkCount[2];
+    uint8_t sideToMove;
+};
+
 class Board {
  private:
     // Two check counters for the two sides
@@ -37,8 +73,6 @@ class Board {
     // checkCount[1] counts the number of checks on the black king
     uint8_t checkCount[2];
 
-    Logger logger;
-
     // An array of piece bitboards
 
     /**
@@ -66,6 +100,11 @@ class Board {
     // A history of the flags before each move:
     std::stack<U64> flagsHistory;
 
+    // Full move number and side to move of the loaded position. toFEN()
+    // adds the moves played since then.
+    int startFullmove;
+    Side startSide;
+
     /**
      * Helper function, sets all en passant-able flags of the side to move to
      * false.
@@ -104,11 +143,39 @@ class Board {
    void resetCastleFlags(enum enumPiece movedPieceIndex, U64 srcPosBitboard,
            enum enumPiece destPieceIndex, U64 destPosBitboard);
 
+    /**
+     * Helper function for eval().
+     * @return How many checks the attacker can give next move, weighted by
+     * piece type, plus its attacks on the squares around the enemy king.
+    */
+    int kingDanger(Side attacker);
+
+    /**
+     * Network accumulators, one for each position in the move history. Only
+     * used when the network is loaded.
+    */
+    std::vector<Accumulator> accumulators;
+
+    /**
+     * Helper function for applyMove().
+     * Pushes an updated accumulator, given the piece bitboards before the
+     * move.
+    */
+    void updateAccumulator(const U64 *oldPieceBB);
+
  public:
     U64 pieceBB[14];
-    U64 pieceHashKeys[64][12];
-    U64 flagHashKeys[20];
-    U64 checkHashKeys[64][2];
+    // Filled from a fixed seed before main starts, shared by every board
+    static U64 pieceHashKeys[64][12];
+    static U64 flagHashKeys[20];
+    static U64 checkHashKeys[64][2];
+    static U64 blackToMoveHashKey;
+
+    // Indexed by side, see AttackCache
+    AttackCache attackCache[2];
+
+    static bool hashKeysReady;
+    static bool initHashKeys(void);
 
     // state vars
     Side sideToMove;
@@ -119,6 +186,34 @@ class Board {
     // Init function that resets the board to initial state
     void init(void);
 
+    /**
+     * Loads a position without regenerating the hash keys, so it is cheap
+     * enough to call for every position of a large batch. The board must
+     * have been initialised once before.
+    */
+    void setPosition(const CompactPosition& pos);
+    void getPosition(CompactPosition *pos);
+
+    // Network accumulator of the current position, only valid when the
+    // network is loaded
+    const Accumulator& getAccumulator(void);
+
+    /**
+     * Loads a position from a FEN string. The check counters may follow the
+     * en passant square as "3+3" (checks left) or the move counters as
+     * "+1+2" (checks given by white and black). Like setPosition(), it
+     * needs an initialised board.
+     * @return Returns false if the string is not a valid FEN.
+    */
+    bool setFromFEN(const std::string& fen);
+
+    /**
+     * Writes the position as a FEN string, followed by the checks given by
+     * white and black as "+N+M". The halfmove clock counts from the last
+     * capture or pawn move, although the engine has no fifty-move rule.
+    */
+    std::string toFEN(void);
+
     // Get bitboard of pieces on the corresponding side
     /* Side is either 0 (white) or 1 (black) */
     U64 getPieceBB(Side side);
@@ -148,13 +243,25 @@ class Board {
     */
     bool undoMove(void);
 
-    int eval();
+    /**
+     * Evaluates the position from the point of view of the side to move.
+     * The expensive terms are skipped when the cheap ones (material, piece
+     * positioning and checks) already put the score far outside the
+     * [alpha, beta] window of the caller.
+    */
+    int eval(int alpha = INT_MIN, int beta = INT_MAX);
 
     U64 hash();
 
     // SAN Move Converters
     uint16_t convertSanToMove(std::string move);
     std::string convertMoveToSan(uint16_t move);
+    /**
+     * Writes the san=0 encoding of a move without allocating, for output
+     * built in a fixed buffer. There is no terminating '\0'.
+     * @return Returns the number of chars written, 4 or 5.
+     */
+    int writeMove(uint16_t move, char *out);
 
     std::string toString(void);
 
@@ -0,0 +1,90 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#include "./board.h"
+#include "./moveGen.h"
+#include "./moveChecker.h"
+#include "./utils.h"
+
+/**
+ * Keys of the Polyglot layout:
+ * [0..767]   - 12 piece kinds * 64 squares, kind = 2 * type + white with the
+ *              types in the pawn, knight, bishop, rook, queen, king order
+ * [768..771] - castling rights: white short, white long, black short, black
+ *              long
+ * [772..779] - file of the en passant square, if a pawn can take on it
+ * [780]      - white to move
+ * [781..786] - 1, 2 or 3 checks received by white, then by black
+ */
+#define BOOK_PIECE_KEYS     768
+#define BOOK_CASTLE_KEYS    768
+#define BOOK_EP_KEYS        772
+#define BOOK_TURN_KEY       780
+#define BOOK_CHECK_KEYS     781
+#define BOOK_KEYS           787
+
+// Bytes of a book entry
+#define BOOK_ENTRY_SIZE     16
+
+/**
+ * Opening book in the Polyglot format: 16 byte big endian entries
+ * (uint64 key, uint16 move, uint16 weight, uint32 learn), sorted by key.
+ * Moves are coded as to file, to row, from file, from row (3 bits each)
+ * and the promotion (1 knight .. 4 queen), castling as the king taking its
+ * own rook.
+ *
+ * The file is mapped into memory and searched in place, so probing reads
+ * a few cache lines and allocates nothing. Like the network, the book is
+ * loaded once at startup and shared by every engine.
+ *
+ * The keys are the standard Polyglot ones, with the check counters
+ * appended: a position where no check was given has its Polyglot key, so
+ * its entries can be shared with other Polyglot books, while the check
+ * keys, from a fixed seed, only come from books built by tools/bookgen.
+ */
+class Book {
+ public:
+    /**
+     * Maps a book file.
+     * @return Returns false if the file is missing or is not a list of
+     * entries, in which case no book is used.
+     */
+    static bool open(std::string fileName);
+    static void close(void);
+
+    static bool isOpen(void);
+
+    // Key of the position in the layout above
+    static U64 key(Board& board);
+
+    // Converts an internal move encoding to the Polyglot one
+    static uint16_t toPolyglotMove(uint16_t move);
+
+    /**
+     * Picks one of the book moves of the position, with a chance
+     * proportional to its weight.
+     * @return Returns the legal move in the internal encoding, or 0xffff if
+     * the position is not in the book.
+     */
+    static uint16_t probe(Board& board, Generator& generator,
+            MoveChecker& checker);
+
+ private:
+    static const uint8_t *data;
+    static size_t entries;
+
+    // Filled before main starts
+    static U64 keys[BOOK_KEYS];
+    static bool keysReady;
+    static bool initKeys(void);
+
+    // Index of the first entry whose key is not less than key
+    static size_t lowerBound(U64 key);
+    static U64 entryKey(size_t index);
+    static uint16_t entryMove(size_t index);
+    static uint16_t entryWeight(size_t index);
+};
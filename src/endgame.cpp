@@ -0,0 +1,263 @@
+/* Copyright 2021 DucaPowr Team */
+#include "./endgame.h"
+
+#include <vector>
+
+#include "./constants.h"
+#include "./tablebase.h"
+
+uint32_t Endgame::kpk[KPK_SIZE / 32];
+bool Endgame::kpkReady = false;
+
+enum KpkResult {
+    KPK_INVALID = 0,
+    KPK_UNKNOWN = 1,
+    KPK_DRAW = 2,
+    KPK_WIN = 4,
+};
+
+static U64 kingAttacks[64];
+
+static U64 pawnAttacks(int square) {
+    int file = square & 7;
+    return (file > 0 ? 1ULL << (square + 7) : 0) |
+        (file < 7 ? 1ULL << (square + 9) : 0);
+}
+
+static void initKingAttacks(void) {
+    for (int square = 0; square < 64; square++) {
+        kingAttacks[square] = 0;
+        for (int dr = -1; dr <= 1; dr++) {
+            for (int df = -1; df <= 1; df++) {
+                int rank = (square >> 3) + dr, file = (square & 7) + df;
+                if ((dr || df) && rank >= 0 && rank < 8 && file >= 0 &&
+                        file < 8) {
+                    kingAttacks[square] |= 1ULL << (8 * rank + file);
+                }
+            }
+        }
+    }
+}
+
+// Whether a queen on square checks target, the white king in between
+static bool queenChecks(int square, int target, int whiteKing) {
+    static const int directions[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1},
+        {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+    for (auto& d : directions) {
+        int rank = (square >> 3) + d[0], file = (square & 7) + d[1];
+        while (rank >= 0 && rank < 8 && file >= 0 && file < 8) {
+            int s = 8 * rank + file;
+            if (s == target) {
+                return true;
+            }
+            if (s == whiteKing) {
+                break;
+            }
+            rank += d[0];
+            file += d[1];
+        }
+    }
+    return false;
+}
+
+static int kpkIndex(Side sideToMove, int whiteKing, int blackKing,
+        int pawn, int checks) {
+    int pawnIndex = ((pawn >> 3) - 1) * 4 + (pawn & 7);
+    return (((checks * 24 + pawnIndex) * 2 + sideToMove) * 64 + blackKing) *
+        64 + whiteKing;
+}
+
+/**
+ * Positions that are decided at once: illegal ones, safe promotions, the
+ * third check given by promoting, mates, stalemates and undefended pawns
+ * the black king takes.
+ */
+static KpkResult kpkInitial(Side side, int wk, int bk, int pawn, int checks) {
+    U64 pawnAttack = pawnAttacks(pawn);
+
+    if (wk == bk || wk == pawn || bk == pawn ||
+            (kingAttacks[wk] & (1ULL << bk)) ||
+            (side == whiteSide && (pawnAttack & (1ULL << bk)))) {
+        return KPK_INVALID;
+    }
+
+    if (side == whiteSide && (pawn >> 3) == 6) {
+        int promotion = pawn + 8;
+        if (promotion != wk && promotion != bk &&
+                ((checks == 2 && queenChecks(promotion, bk, wk)) ||
+                !(kingAttacks[bk] & (1ULL << promotion)) ||
+                (kingAttacks[wk] & (1ULL << promotion)))) {
+            return KPK_WIN;
+        }
+    }
+
+    if (side == blackSide) {
+        U64 moves = kingAttacks[bk] & ~(kingAttacks[wk] | pawnAttack);
+        if (!moves) {
+            return (pawnAttack & (1ULL << bk)) ? KPK_WIN : KPK_DRAW;
+        }
+        if (moves & (1ULL << pawn)) {
+            return KPK_DRAW;
+        }
+    }
+
+    return KPK_UNKNOWN;
+}
+
+// Reads the results of the children of an undecided position
+static KpkResult kpkClassify(const std::vector<uint8_t>& db, Side side,
+        int wk, int bk, int pawn, int checks) {
+    int found = 0;
+
+    if (side == whiteSide) {
+        U64 moves = kingAttacks[wk] & ~kingAttacks[bk] & ~(1ULL << pawn);
+        while (moves) {
+            int to = __builtin_ctzll(moves);
+            moves &= moves - 1;
+            found |= db[kpkIndex(blackSide, to, bk, pawn, checks)];
+        }
+
+        // Pushes to the last rank were scored as promotions
+        for (int to = pawn + 8; (pawn >> 3) < 6 && to != wk && to != bk;
+                to += 8) {
+            if (pawnAttacks(to) & (1ULL << bk)) {
+                if (checks == 2) {
+                    return KPK_WIN;
+                }
+                found |= db[kpkIndex(blackSide, wk, bk, to, checks + 1)];
+            } else {
+                found |= db[kpkIndex(blackSide, wk, bk, to, checks)];
+            }
+
+            // Only a pawn on its first rank moves two squares
+            if ((pawn >> 3) != 1 || to != pawn + 8) {
+                break;
+            }
+        }
+
+        return found & KPK_WIN ? KPK_WIN :
+            found & KPK_UNKNOWN ? KPK_UNKNOWN : KPK_DRAW;
+    }
+
+    U64 moves = kingAttacks[bk] & ~kingAttacks[wk] & ~pawnAttacks(pawn) &
+        ~(1ULL << pawn);
+    while (moves) {
+        int to = __builtin_ctzll(moves);
+        moves &= moves - 1;
+        found |= db[kpkIndex(whiteSide, wk, to, pawn, checks)];
+    }
+
+    return found & KPK_DRAW ? KPK_DRAW :
+        found & KPK_UNKNOWN ? KPK_UNKNOWN : KPK_WIN;
+}
+
+void Endgame::init(void) {
+    if (kpkReady) {
+        return;
+    }
+    initKingAttacks();
+
+    std::vector<uint8_t> db(KPK_SIZE);
+    auto decode = [](int i, Side *side, int *wk, int *bk, int *pawn,
+            int *checks) {
+        *wk = i & 63;
+        *bk = (i >> 6) & 63;
+        *side = static_cast<Side>((i >> 12) & 1);
+        int pawnIndex = (i >> 13) % 24;
+        *pawn = 8 * (pawnIndex / 4 + 1) + pawnIndex % 4;
+        *checks = (i >> 13) / 24;
+    };
+
+    Side side;
+    int wk, bk, pawn, checks;
+    for (int i = 0; i < KPK_SIZE; i++) {
+        decode(i, &side, &wk, &bk, &pawn, &checks);
+        db[i] = kpkInitial(side, wk, bk, pawn, checks);
+    }
+
+    // Until nothing changes; the positions left unknown are draws, white
+    // cannot force a win from them
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < KPK_SIZE; i++) {
+            if (db[i] != KPK_UNKNOWN) {
+                continue;
+            }
+            decode(i, &side, &wk, &bk, &pawn, &checks);
+            db[i] = kpkClassify(db, side, wk, bk, pawn, checks);
+            changed |= db[i] != KPK_UNKNOWN;
+        }
+    }
+
+    for (int i = 0; i < KPK_SIZE; i++) {
+        if (db[i] == KPK_WIN) {
+            kpk[i / 32] |= 1u << (i % 32);
+        }
+    }
+    kpkReady = true;
+}
+
+bool Endgame::probeKpk(Side sideToMove, int whiteKing, int blackKing,
+        int pawn, int checks) {
+    int i = kpkIndex(sideToMove, whiteKing, blackKing, pawn, checks);
+    return kpk[i / 32] & (1u << (i % 32));
+}
+
+bool Endgame::probeKpkBoard(Board& board, const CompactPosition& pos,
+        int *score) {
+    Side strong = board.pieceBB[nWhitePawn] ? whiteSide : blackSide;
+    Side weak = otherSide(strong);
+
+    // The pawn side plays white, up the board, on files a-d
+    int flip = (strong == blackSide ? 56 : 0);
+    int pawn = getSquareIndex(board.pieceBB[nWhitePawn + strong]) ^ flip;
+    int mirror = (pawn & 7) >= 4 ? 7 : 0;
+    pawn ^= mirror;
+    flip ^= mirror;
+    int whiteKing = getSquareIndex(board.pieceBB[nWhiteKing + strong]) ^ flip;
+    int blackKing = getSquareIndex(board.pieceBB[nWhiteKing + weak]) ^ flip;
+    Side side = board.sideToMove == strong ? whiteSide : blackSide;
+
+    if (!probeKpk(side, whiteKing, blackKing, pawn, pos.checkCount[weak])) {
+        *score = 0;
+        return true;
+    }
+
+    // The further the pawn, the better, so the search makes progress
+    int win = KNOWN_WIN_SCORE + 10 * (pawn >> 3);
+    *score = side == whiteSide ? win : -win;
+    return true;
+}
+
+bool Endgame::probe(Board& board, int *score) {
+    // The tables know the distance to the win, so they come first
+    if (Tablebases::probe(board, score)) {
+        return true;
+    }
+
+    // Dispatch on the material: bare kings, or kings and one pawn
+    int pieces = __builtin_popcountll(board.getAllBB());
+    if (pieces > 3) {
+        return false;
+    }
+
+    // A game that is over is left to the eval
+    CompactPosition pos;
+    board.getPosition(&pos);
+    if (pos.checkCount[whiteSide] >= 3 || pos.checkCount[blackSide] >= 3) {
+        return false;
+    }
+
+    if (pieces == 2) {
+        // Kings never give check
+        *score = 0;
+        return true;
+    }
+    if (kpkReady &&
+            (board.pieceBB[nWhitePawn] | board.pieceBB[nBlackPawn])) {
+        return probeKpkBoard(board, pos, score);
+    }
+    return false;
+}
@@ -0,0 +1,57 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include <stdint.h>
+
+#include "./board.h"
+#include "./utils.h"
+
+/**
+ * KPK bitbase index, for the side with the pawn as white and the pawn on
+ * files a-d: black king (64) * white king (64) * side to move (2) * pawn on
+ * ranks 2-7 (24) * checks the black king already received (0-2). The black
+ * king is the only one that can be checked, so its counter is the only one
+ * that matters.
+ */
+#define KPK_SIZE (64 * 64 * 2 * 24 * 3)
+
+/**
+ * Recognizes endgames whose result is known without searching them. The
+ * search looks up the material of every node; a recognized position gets
+ * its score at once.
+ *
+ * Note: in 3-check the minor pieces give checks, so KNK, KBK and the other
+ * insufficient material draws of chess are not draws here. Only the bare
+ * kings are, and KPK is read from a bitbase that counts the pawn's checks.
+ * Endgames with tables, see tablebase.h, are read from them first.
+ */
+class Endgame {
+ public:
+    /**
+     * Builds the KPK bitbase by retrograde analysis. Until then only the
+     * bare kings are recognized.
+     */
+    static void init(void);
+
+    /**
+     * @param score gets the score of a recognized position, from the point
+     * of view of the side to move
+     * @return Returns false if the material is not recognized.
+     */
+    static bool probe(Board& board, int *score);
+
+    /**
+     * @return Returns true if the side with the pawn wins the KPK position.
+     * The squares are normalized: pawn side as white, pawn on files a-d.
+     */
+    static bool probeKpk(Side sideToMove, int whiteKing, int blackKing,
+        int pawn, int checks);
+
+ private:
+    // One bit per position, set if white wins
+    static uint32_t kpk[KPK_SIZE / 32];
+    static bool kpkReady;
+
+    static bool probeKpkBoard(Board& board, const CompactPosition& pos,
+        int *score);
+};
@@ -2,18 +2,93 @@
 #include "./engine.h"
 #include "./logger.h"
 
+#include <chrono>
 #include <istream>
 #include <time.h>
 #include <climits>
 
+Engine::Engine()
+    : table(std::make_shared<TranspositionTable>(DEFAULT_HASH_MB)) {
+}
+
+Engine::Engine(std::shared_ptr<TranspositionTable> sharedTable)
+    : table(sharedTable), ownsTable(false) {
+}
+
 /**
  * Resets the game and makes engine play black.
  */
 void Engine::newGame(void) {
     _board.init();
+    checkHistory.clear();
+    clearHash();
     running = true;
 }
 
+Engine::~Engine() {
+    stopSearch();
+}
+
+void Engine::setHashSize(size_t sizeMB) {
+    if (!ownsTable) {
+        return;
+    }
+    table->resize(std::max(sizeMB, static_cast<size_t>(1)), threads);
+}
+
+void Engine::setThreads(unsigned int count) {
+    threads = std::max(count, 1u);
+
+    // The old workers are joined before their engines go away
+    helperPool.reset();
+    helpers.clear();
+    if (threads == 1) {
+        return;
+    }
+
+    for (unsigned int i = 1; i < threads; i++) {
+        helpers.emplace_back(new Engine(table));
+        helpers.back()->depthOffset = i % 2;
+    }
+    helperPool.reset(new ThreadPool(threads - 1));
+}
+
+void Engine::clearHash(void) {
+    if (!ownsTable) {
+        return;
+    }
+    table->clear(threads);
+}
+
+void Engine::startHelpers(void) {
+    SearchLimits infinite;
+    infinite.infinite = true;
+
+    for (auto& helper : helpers) {
+        Engine *engine = helper.get();
+        engine->_board = _board;
+        engine->stopRequested = false;
+        helperPool->submit([engine, infinite](unsigned int) {
+            engine->think(infinite);
+        });
+    }
+}
+
+void Engine::stopHelpers(void) {
+    if (helpers.empty()) {
+        return;
+    }
+
+    for (auto& helper : helpers) {
+        helper->stopRequested = true;
+    }
+    helperPool->wait();
+
+    for (auto& helper : helpers) {
+        stats.helperNodes += helper->stats.nodes;
+    }
+}
+
 /**
  * Opponent moved
  *
@@ -22,13 +97,12 @@ void Engine::newGame(void) {
 void Engine::userMove(std::string move) {
     _board.applyMove(_board.convertSanToMove(move));
     U64 attacksAfterApplyMove = _generator.getAttackBB(otherSide(_board.sideToMove));
-    if (_checker.isCheck(attacksAfterApplyMove)) {
+    checkHistory.push_back(_checker.isCheck(attacksAfterApplyMove));
+    if (checkHistory.back()) {
         _board.updateCheckCounter(1, _board.sideToMove);
     }
 
-    if (DEBUG) {
-        _logger.raw(_board.toString() + '\n');
-    }
+    LOG_DEBUG(_board.toString());
 }
 
 /**
@@ -36,30 +110,291 @@ void Engine::userMove(std::string move) {
  *
  * @return SAN=0 encoding of the move
  */
-std::string Engine::move(void) {
-    uint16_t move = 0xffff;
-
-    int depth = 7;
-
-    int score = alphaBetaMax(INT_MIN, INT_MAX, depth, &move);
+std::string Engine::move(const SearchLimits& limits) {
+    int score = 0;
+    // Book moves take no time off the clock
+    uint16_t move = Book::probe(_board, _generator, _checker);
+    if (move == 0xffff) {
+        move = think(limits, &score);
+    } else {
+        // Nothing was searched for this move
+        stats.clear();
+        LOG_INFO("Book move " + _board.convertMoveToSan(move));
+    }
 
     _board.applyMove(move);
     U64 attacksAfterApplyMove = _generator.getAttackBB(otherSide(_board.sideToMove));
-    if (_checker.isCheck(attacksAfterApplyMove)) {
+    checkHistory.push_back(_checker.isCheck(attacksAfterApplyMove));
+    if (checkHistory.back()) {
         _board.updateCheckCounter(1, _board.sideToMove);
     }
 
-    if (DEBUG) {
-        _logger.raw("Attacks BB\n");
-        _logger.logBB(attacksAfterApplyMove);
-        _logger.raw(_board.toString() + '\n');
-        _logger.raw("Score for move: " + std::to_string(score));
-    }
+    // The frontends log the search stats once the move is sent
+    LOG_DEBUG("Attacks BB\n" + Logger::bbToString(attacksAfterApplyMove) +
+        '\n' + _board.toString() + "\nScore for move: " +
+        std::to_string(score));
 
     // return san representation
     return _board.convertMoveToSan(move);
 }
 
+uint16_t Engine::search(int depth, int *score) {
+    uint16_t move = 0xffff;
+    // The PV table ends there
+    depth = std::min(depth, MAX_SEARCH_DEPTH);
+    stats.clear();
+    rootDepth = depth;
+    rootBestMove = 0xffff;
+    timed = false;
+    stopped = false;
+
+    searchStart = std::chrono::steady_clock::now();
+    int bestScore = alphaBetaMax(INT_MIN, INT_MAX, depth, &move);
+    stats.seconds = elapsed();
+    stats.depth = depth;
+    if (depth < STATS_MAX_PLY) {
+        stats.iterationNodes[depth] = stats.nodes;
+        stats.iterationSeconds[depth] = stats.seconds;
+    }
+    if (score != NULL) {
+        *score = bestScore;
+    }
+
+    return move;
+}
+
+uint16_t Engine::think(const SearchLimits& limits, int *score) {
+    stats.clear();
+    rootBestMove = 0xffff;
+    stopped = false;
+    searchStart = std::chrono::steady_clock::now();
+    allocateTime(limits);
+
+    nodeLimit = limits.nodes;
+    startHelpers();
+    int maxDepth = limits.depth > 0 ? limits.depth :
+        timed || limits.infinite || nodeLimit ? MAX_SEARCH_DEPTH :
+        DEFAULT_SEARCH_DEPTH;
+    maxDepth = std::min(maxDepth, MAX_SEARCH_DEPTH);
+
+    uint16_t bestMove = 0xffff;
+    int bestScore = 0;
+    for (int depth = 1 + depthOffset; depth <= maxDepth; depth++) {
+        uint16_t move = 0xffff;
+        U64 nodesBefore = stats.nodes;
+        double start = elapsed();
+
+        rootDepth = depth;
+        int iterationScore = alphaBetaMax(INT_MIN, INT_MAX, depth, &move);
+        if (stopped) {
+            break;
+        }
+        progressDepth.store(depth, std::memory_order_relaxed);
+
+        bestMove = rootBestMove = move;
+        bestScore = iterationScore;
+        stats.depth = depth;
+        stats.iterationNodes[depth] = stats.nodes - nodesBefore;
+        stats.iterationSeconds[depth] = elapsed() - start;
+        stats.iterationMoves[depth] = move;
+        printThinking(depth, iterationScore);
+
+        // No legal move, or the next iteration would most likely be cut
+        if (move == 0xffff || (timed && elapsed() >= softLimit)) {
+            break;
+        }
+    }
+
+    stopHelpers();
+    stats.seconds = elapsed();
+    if (score != NULL) {
+        *score = bestScore;
+    }
+
+    return bestMove;
+}
+
+/**
+ * The soft limit is an even share of the clock for the moves left until
+ * the next time control, the hard limit lets a promising iteration go on
+ * for a while longer. A fixed time per move (st) is used whole.
+ */
+void Engine::allocateTime(const SearchLimits& limits) {
+    timed = true;
+
+    if (limits.moveTime > 0) {
+        hardLimit = std::max(limits.moveTime - MOVE_OVERHEAD,
+            limits.moveTime / 2);
+        softLimit = hardLimit;
+        return;
+    }
+
+    if (limits.time < 0) {
+        timed = false;
+        return;
+    }
+
+    double left = std::max(limits.time - MOVE_OVERHEAD, 0.0);
+    int movesToGo = limits.movesToGo > 0 ?
+        limits.movesToGo : DEFAULT_MOVES_TO_GO;
+
+    double share = left / movesToGo + limits.increment * 3 / 4;
+    hardLimit = std::min(share * 4, left / 2);
+    // Half of the share, since the next iteration takes several times as
+    // long as the last one
+    softLimit = std::min(share / 2, hardLimit);
+}
+
+double Engine::elapsed(void) {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - searchStart).count();
+}
+
+bool Engine::outOfTime(void) {
+    // The first iteration always completes, so there is a move to play
+    if (!stopped && rootDepth > 1 &&
+            (stats.nodes & (CLOCK_CHECK_NODES - 1)) == 0) {
+        progressNodes.store(stats.nodes, std::memory_order_relaxed);
+        stopped = stopRequested.load(std::memory_order_relaxed) ||
+            (timed && elapsed() >= hardLimit) ||
+            (nodeLimit && stats.nodes >= nodeLimit);
+    }
+    return stopped;
+}
+
+void Engine::startSearch(const SearchLimits& limits,
+        std::function<void(const std::string&)> onDone) {
+    stopSearch();
+
+    stopRequested = false;
+    progressNodes = 0;
+    progressDepth = 0;
+    backgroundStart = std::chrono::steady_clock::now();
+
+    searchThread = std::thread([this, limits, onDone]() {
+        // An analysis is never answered from the book
+        uint16_t move = limits.infinite ? 0xffff :
+            Book::probe(_board, _generator, _checker);
+        if (move == 0xffff) {
+            move = think(limits);
+        }
+        if (onDone) {
+            onDone(move == 0xffff ? "0000" : _board.convertMoveToSan(move));
+        }
+    });
+}
+
+void Engine::stopSearch(void) {
+    if (searchThread.joinable()) {
+        stopRequested = true;
+        searchThread.join();
+        stopRequested = false;
+    }
+}
+
+void Engine::searchProgress(double *seconds, U64 *nodes, int *depth) {
+    *seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - backgroundStart).count();
+    *nodes = progressNodes.load(std::memory_order_relaxed);
+    *depth = progressDepth.load(std::memory_order_relaxed);
+}
+
+bool Engine::undoMove(void) {
+    if (checkHistory.empty()) {
+        return false;
+    }
+
+    // The side to move received the check, if there was one
+    if (checkHistory.back()) {
+        _board.updateCheckCounter(-1, _board.sideToMove);
+    }
+    checkHistory.pop_back();
+    _board.undoMove();
+
+    return true;
+}
+
+void Engine::setThinkingOutput(
+        std::function<void(const std::string&)> output) {
+    thinkingOutput = output;
+}
+
+void Engine::setUciOutput(bool uci) {
+    uciOutput = uci;
+}
+
+void Engine::updatePv(int ply, uint16_t move) {
+    pv[ply][ply] = move;
+    for (int i = ply + 1; i < pvLength[ply + 1]; i++) {
+        pv[ply][i] = pv[ply + 1][i];
+    }
+    pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+}
+
+void Engine::printThinking(int depth, int score) {
+    if (!thinkingOutput) {
+        return;
+    }
+
+    // A won game (mate or third check) ends the PV. UCI gives it in moves,
+    // negative when the engine loses, xboard as a large score.
+    bool won = score == INT_MAX, lost = score == INT_MIN;
+    if (won || lost) {
+        score = won ? THINKING_MATE_SCORE : -THINKING_MATE_SCORE;
+    }
+    int mateMoves = (pvLength[0] + 1) / 2;
+
+    // xboard wants the time in centiseconds, UCI in milliseconds
+    double seconds = elapsed();
+    unsigned long long nodes = stats.nodes;
+    int len;
+    if (uciOutput) {
+        len = snprintf(thinkingLine, THINKING_LINE_SIZE,
+            "info depth %d score %s %d time %d nodes %llu nps %llu pv",
+            depth, won || lost ? "mate" : "cp",
+            won ? mateMoves : lost ? -mateMoves : score,
+            static_cast<int>(seconds * 1000), nodes,
+            static_cast<unsigned long long>(nodes / std::max(seconds, 1e-3)));
+    } else {
+        len = snprintf(thinkingLine, THINKING_LINE_SIZE, "%d %d %d %llu",
+            depth, score, static_cast<int>(seconds * 100), nodes);
+    }
+
+    // A move takes at most 6 chars
+    for (int i = 0; i < pvLength[0] && len + 7 < THINKING_LINE_SIZE; i++) {
+        thinkingLine[len++] = ' ';
+        len += _board.writeMove(pv[0][i], thinkingLine + len);
+    }
+
+    thinkingText.assign(thinkingLine, len);
+    thinkingOutput(thinkingText);
+}
+
+U64 Engine::searchedNodes(void) {
+    return stats.nodes;
+}
+
+const SearchStats& Engine::searchStats(void) {
+    return stats;
+}
+
+bool Engine::setPosition(std::string fen) {
+    checkHistory.clear();
+    return _board.setFromFEN(fen);
+}
+
+std::string Engine::toFEN(void) {
+    return _board.toFEN();
+}
+
+uint16_t Engine::parseSan(std::string san) {
+    return ::parseSan(_board, _generator, _checker, san);
+}
+
+std::string Engine::moveToSan(uint16_t move) {
+    return ::moveToSan(_board, _generator, _checker, move);
+}
+
 void Engine::close(void) {
     running = false;
 }
@@ -72,13 +407,120 @@ Side Engine::sideToMove(void) {
     return _board.sideToMove;
 }
 
+U64 Engine::perft(int depth) {
+    return Perft(_board, _generator, _checker).run(depth);
+}
+
+void Engine::perftReport(int depth, bool divide, unsigned int threads,
+        std::ostream& out) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::pair<uint16_t, U64>> rootCounts;
+    U64 nodes = parallelPerft(_board, depth, threads, PERFT_HASH_MB,
+        divide ? &rootCounts : NULL);
+
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    for (auto& rootCount : rootCounts) {
+        out << _board.convertMoveToSan(rootCount.first) << ' ' <<
+            rootCount.second << '\n';
+    }
+
+    out << "Nodes: " << nodes << '\n';
+    out << "Time: " << seconds << " s\n";
+    out << "NPS: " << static_cast<U64>(nodes / std::max(seconds, 1e-9)) <<
+        std::endl;
+}
 
 #include <cassert>
+// Negates a score, swapping INT_MIN and INT_MAX, the lost/won bounds.
+static int negateScore(int score) {
+    return score == INT_MIN ? INT_MAX : score == INT_MAX ? INT_MIN : -score;
+}
+
+// The bound of a stored score seen from the other side
+static Bound flipBound(Bound bound) {
+    return bound == BOUND_EXACT ? BOUND_EXACT :
+        bound == BOUND_LOWER ? BOUND_UPPER : BOUND_LOWER;
+}
+
+/**
+ * Whether a stored result decides the node without searching it. The
+ * score of the entry and the window are from the same point of view, and
+ * the search fails hard, so the score returned is kept inside the window.
+ */
+static bool hashCutoff(const TTEntry& entry, int alpha, int beta,
+        int *score) {
+    if (entry.bound == BOUND_EXACT) {
+        *score = std::max(alpha, std::min(entry.score, beta));
+        return true;
+    }
+    if (entry.bound == BOUND_LOWER && entry.score >= beta) {
+        *score = beta;
+        return true;
+    }
+    if (entry.bound == BOUND_UPPER && entry.score <= alpha) {
+        *score = alpha;
+        return true;
+    }
+    return false;
+}
+
+// Searches the hash move first, if it is one of the moves
+static void orderHashMove(uint16_t *moves, uint16_t movesLen,
+        uint16_t hashMove) {
+    uint16_t *found = std::find(moves, moves + movesLen, hashMove);
+    if (hashMove != 0xffff && found != moves + movesLen) {
+        std::swap(*found, moves[0]);
+    }
+}
+
 // ALPHA-BETA
 int Engine::alphaBetaMax(int alpha, int beta, int depthleft, uint16_t *move) {
+    stats.nodes++;
+    int ply = rootDepth - depthleft;
+    assert(ply <= MAX_SEARCH_DEPTH);
+    if (ply < STATS_MAX_PLY) {
+        stats.plyNodes[ply]++;
+    }
+    pvLength[ply] = ply;
+
+    // The result is thrown away
+    if (outOfTime()) {
+        return alpha;
+    }
+
+    // Known endgames are not searched, the root still needs a move
+    int known;
+    if (ply > 0 && Endgame::probe(_board, &known)) {
+        stats.endgameHits++;
+        return std::max(alpha, std::min(known, beta));
+    }
+
     // if i'm last node return my eval
     if ( depthleft == 0 ) {
-        return (_board.eval());
+        stats.evalCalls++;
+        return (_board.eval(alpha, beta));
+    }
+
+    // The root side is to move, so the stored scores are from its point of
+    // view, like the window
+    U64 key = _board.hash();
+    uint16_t hashMove = 0xffff;
+    TTEntry entry;
+    stats.ttProbes++;
+    if (table->probe(key, &entry)) {
+        stats.ttHits++;
+        hashMove = entry.move;
+
+        // The root is always searched, it has to return a move
+        int hashScore;
+        if (ply > 0 && entry.depth >= depthleft &&
+                hashCutoff(entry, alpha, beta, &hashScore)) {
+            stats.ttCutoffs++;
+            return hashScore;
+        }
     }
 
     uint16_t moves[MAX_MOVES_AT_STEP];
@@ -89,12 +531,20 @@ int Engine::alphaBetaMax(int alpha, int beta, int depthleft, uint16_t *move) {
     U64 attackBB = _generator.getAttackBB(otherSide(_board.sideToMove));
 
     // todo sort moves (here or in generateMoves)
+    orderHashMove(moves, movesLen, hashMove);
+    if (ply == 0 && rootBestMove != 0xffff) {
+        std::swap(*std::find(moves, moves + movesLen, rootBestMove), moves[0]);
+    }
 
     int score = INT_MIN;
     uint16_t currMove;
+    uint16_t bestMove = hashMove;
+    int origAlpha = alpha;
+    int legalMoves = 0;
 
     for (int i = 0; i < movesLen; ++i) {
         currMove = moves[i];
+        stats.pseudoLegalMoves++;
 
         if (!_checker.isLegal(currMove, attackBB))
             continue;
@@ -106,6 +556,9 @@ int Engine::alphaBetaMax(int alpha, int beta, int depthleft, uint16_t *move) {
             _board.undoMove();
             continue;
         }
+        stats.legalMoves++;
+        legalMoves++;
+
         U64 attacksAfterApplyMove = _generator.getAttackBB(otherSide(_board.sideToMove));
         if (_checker.isCheck(attacksAfterApplyMove)) {
             _board.updateCheckCounter(1, _board.sideToMove);
@@ -120,21 +573,93 @@ int Engine::alphaBetaMax(int alpha, int beta, int depthleft, uint16_t *move) {
         }
         _board.undoMove();
 
+        // Even a lost game needs a move to play
+        if (ply == 0 && legalMoves == 1) {
+            *move = currMove;
+            updatePv(ply, currMove);
+        }
+
         if( score >= beta ) {
+            stats.cutoffs++;
+            stats.firstMoveCutoffs += (legalMoves == 1);
+            // At the root this is a won game (beta is INT_MAX), and the
+            // winning move must still be returned
+            *move = currMove;
+            updatePv(ply, currMove);
+            if (!stopped) {
+                table->store(key, beta, currMove, depthleft, BOUND_LOWER);
+            }
             return beta;   // fail hard beta-cutoff
         }
         if( score > alpha ) {
             alpha = score; // alpha acts like max in MiniMax
             *move = currMove;
+            bestMove = currMove;
+            updatePv(ply, currMove);
+
+            // The previous iteration preferred another move
+            if (ply == 0 && rootBestMove != 0xffff &&
+                    currMove != rootBestMove && !stopped) {
+                printThinking(rootDepth, score);
+            }
         }
     }
+
+    // A stopped search returns scores that are not worth keeping
+    if (!stopped) {
+        table->store(key, alpha, bestMove, depthleft,
+            alpha > origAlpha ? BOUND_EXACT : BOUND_UPPER);
+    }
     return alpha;
 }
 
 int Engine::alphaBetaMin(int alpha, int beta, int depthleft, uint16_t *move) {
+    stats.nodes++;
+    int ply = rootDepth - depthleft;
+    assert(ply <= MAX_SEARCH_DEPTH);
+    if (ply < STATS_MAX_PLY) {
+        stats.plyNodes[ply]++;
+    }
+    pvLength[ply] = ply;
+
+    if (outOfTime()) {
+        return beta;
+    }
+
+    // The score of the opponent, who is to move
+    int known;
+    if (Endgame::probe(_board, &known)) {
+        stats.endgameHits++;
+        known = negateScore(known);
+        return std::max(alpha, std::min(known, beta));
+    }
+
     // if i'm last node return my eval
     if ( depthleft == 0 ) {
-        return -(_board.eval());
+        stats.evalCalls++;
+        // The opponent's eval, so the window is mirrored as well
+        return negateScore(_board.eval(negateScore(beta),
+            negateScore(alpha)));
+    }
+
+    // The opponent is to move here, its stored scores are turned to the
+    // root side's point of view
+    U64 key = _board.hash();
+    uint16_t hashMove = 0xffff;
+    TTEntry entry;
+    stats.ttProbes++;
+    if (table->probe(key, &entry)) {
+        stats.ttHits++;
+        hashMove = entry.move;
+        entry.score = negateScore(entry.score);
+        entry.bound = flipBound(entry.bound);
+
+        int hashScore;
+        if (entry.depth >= depthleft &&
+                hashCutoff(entry, alpha, beta, &hashScore)) {
+            stats.ttCutoffs++;
+            return hashScore;
+        }
     }
 
     uint16_t moves[MAX_MOVES_AT_STEP];
@@ -144,12 +669,17 @@ int Engine::alphaBetaMin(int alpha, int beta, int depthleft, uint16_t *move) {
     U64 attackBB = _generator.getAttackBB(otherSide(_board.sideToMove));
 
     // todo sort moves (here or in generateMoves)
+    orderHashMove(moves, movesLen, hashMove);
 
     int score = INT_MAX;
     uint16_t currMove;
+    uint16_t bestMove = hashMove;
+    int origBeta = beta;
+    int legalMoves = 0;
 
     for (int i = 0; i < movesLen; ++i) {
         currMove = moves[i];
+        stats.pseudoLegalMoves++;
 
         if (!_checker.isLegal(currMove, attackBB))
             continue;
@@ -161,6 +691,9 @@ int Engine::alphaBetaMin(int alpha, int beta, int depthleft, uint16_t *move) {
             _board.undoMove();
             continue;
         }
+        stats.legalMoves++;
+        legalMoves++;
+
         U64 attacksAfterApplyMove = _generator.getAttackBB(otherSide(_board.sideToMove));
         if (_checker.isCheck(attacksAfterApplyMove)) {
             _board.updateCheckCounter(1, _board.sideToMove);
@@ -176,12 +709,24 @@ int Engine::alphaBetaMin(int alpha, int beta, int depthleft, uint16_t *move) {
         _board.undoMove();
 
         if( score <= alpha ) {
+            stats.cutoffs++;
+            stats.firstMoveCutoffs += (legalMoves == 1);
+            if (!stopped) {
+                table->store(key, negateScore(alpha), currMove, depthleft,
+                    BOUND_LOWER);
+            }
             return alpha; // fail hard alpha-cutoff
         }
         if( score < beta ) {
             beta = score; // beta acts like min in MiniMax
+            bestMove = currMove;
+            updatePv(ply, currMove);
         }
     }
+
+    if (!stopped) {
+        table->store(key, negateScore(beta), bestMove, depthleft,
+            beta < origBeta ? BOUND_EXACT : BOUND_UPPER);
+    }
     return beta;
 }
-
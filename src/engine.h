@@ -2,7 +2,14 @@
 #pragma once
 
 #include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <ostream>
 #include <string>
+#include <thread>
+#include <vector>
 #include <bitset>
 
 // todo delete these 2
@@ -10,17 +17,81 @@
 #include <random>
 
 #include "./board.h"
+#include "./book.h"
 #include "./moveGen.h"
 #include "./constants.h"
+#include "./endgame.h"
 #include "./moveChecker.h"
+#include "./perft.h"
+#include "./san.h"
+#include "./searchLimits.h"
+#include "./searchStats.h"
+#include "./threadPool.h"
+#include "./transpositionTable.h"
 
 class Engine {
  public:
+    Engine();
     /**
-     * Resets the game and makes engine play black.
+     * An engine that searches with a table shared with other engines, eg:
+     * the games of a server. A shared table is neither resized nor cleared
+     * by this engine.
+     */
+    explicit Engine(std::shared_ptr<TranspositionTable> sharedTable);
+    ~Engine();
+
+    /**
+     * Resets the game and makes engine play black. The transposition table
+     * is cleared as well.
      */
     void newGame();
 
+    /**
+     * Reallocates the transposition table (xboard memory, UCI Hash) and
+     * clears it.
+     *
+     * @param sizeMB the size of the table, in MB
+     */
+    void setHashSize(size_t sizeMB);
+
+    /**
+     * Sets the number of threads think() searches with (xboard cores, UCI
+     * Threads). The helper threads run the same iterative deepening on
+     * their own copy of the position and only share the transposition
+     * table with the main one (Lazy SMP).
+     */
+    void setThreads(unsigned int threads);
+
+    // Forgets every stored position, so the next search is repeatable
+    void clearHash();
+
+    /**
+     * Takes back the last move played through userMove() or move().
+     *
+     * @return Returns false if there is no move to take back.
+     */
+    bool undoMove();
+
+    /**
+     * Starts think() on the current position on a background thread, which
+     * reports through the thinking output. Nothing else may touch the
+     * engine until stopSearch() returns.
+     *
+     * @param limits the limits of the search, infinite for an analysis
+     * @param onDone if set, gets the best move in san=0 encoding ("0000" if
+     * there is none) on the search thread once the search ends
+     */
+    void startSearch(const SearchLimits& limits,
+        std::function<void(const std::string&)> onDone = nullptr);
+    // Stops the background search and waits for it
+    void stopSearch();
+
+    /**
+     * Progress of the background search: seconds since it started, nodes
+     * searched and last completed depth. Safe to call while it runs.
+     */
+    void searchProgress(double *seconds, U64 *nodes, int *depth);
+
     /**
      * Opponent moved
      *
@@ -28,12 +99,75 @@ class Engine {
      */
     void userMove(std::string move);
 
+    /**
+     * Sends UCI "info" lines instead of xboard thinking lines.
+     */
+    void setUciOutput(bool uci);
+
     /**
      * Engine thinks and moves the color that has to move this turn
      *
+     * @param limits the depth and the time the search may use
      * @return san=0 encoding of the move; eg: e2e4
      */
-    std::string move();
+    std::string move(const SearchLimits& limits = SearchLimits());
+
+    /**
+     * Iterative deepening search within the limits, without playing the
+     * best move. An iteration cut short by the clock is thrown away.
+     *
+     * @param score if not NULL, gets the score of the best move
+     * @return the best move, 0xffff if there is no legal move
+     */
+    uint16_t think(const SearchLimits& limits, int *score = NULL);
+
+    /**
+     * Searches the current position without playing the best move.
+     *
+     * @param depth the depth of the search, in plies
+     * @param score if not NULL, gets the score of the best move
+     * @return the best move, 0xffff if there is no legal move
+     */
+    uint16_t search(int depth, int *score = NULL);
+
+    /**
+     * Sends a thinking line (depth score time nodes pv, in the xboard
+     * format, without the '\n') after every iteration of think() and
+     * whenever the best root move changes, or stops them if output is
+     * empty. The lines come from the search thread, so the frontend writes
+     * them under the lock of its other answers.
+     */
+    void setThinkingOutput(std::function<void(const std::string&)> output);
+
+    /**
+     * Nodes visited by the last search
+     */
+    U64 searchedNodes();
+
+    /**
+     * Counters of the last search
+     */
+    const SearchStats& searchStats();
+
+    /**
+     * Loads a position.
+     *
+     * @return Returns false if the FEN is invalid.
+     */
+    bool setPosition(std::string fen);
+
+    /**
+     * FEN of the current position, with the check counters, see
+     * Board::toFEN.
+     */
+    std::string toFEN();
+
+    /**
+     * Converts between standard algebraic notation and the internal move
+     * encoding, on the current position. See san.h.
+     */
+    uint16_t parseSan(std::string san);
+    std::string moveToSan(uint16_t move);
 
     /**
      * Closes the engines which terminates the program
@@ -46,14 +180,99 @@ class Engine {
     bool isRunning();
 
     Side sideToMove();
+
+    /**
+     * Counts the leaves of the legal move tree of the current position.
+     * At depth 1 the legal moves are counted instead of being recursed
+     * into.
+     *
+     * @param depth the depth of the tree, in plies
+     */
+    U64 perft(int depth);
+
+    /**
+     * Runs a parallel, hashed perft on the current position and prints the
+     * node count, the time and the speed.
+     *
+     * @param divide also print the node count under every root move
+     * @param threads the number of threads, 0 for all hardware threads
+     */
+    void perftReport(int depth, bool divide, unsigned int threads,
+        std::ostream& out);
  private:
     Board _board;
     Generator _generator{_board};
     MoveChecker _checker{_board};
-    Logger _logger;
 
     bool running = true;
 
+    SearchStats stats;
+
+    // Helpers of the Lazy SMP search share the table of the main engine
+    std::shared_ptr<TranspositionTable> table;
+    bool ownsTable = true;
+
+    // Threads of think(), the main one included
+    unsigned int threads = 1;
+    // Only the helper running on helperPool touches its engine while a
+    // search runs. The pool is declared last, so it is joined before the
+    // helpers are destroyed.
+    std::vector<std::unique_ptr<Engine>> helpers;
+    std::unique_ptr<ThreadPool> helperPool;
+    // Every other helper starts one ply deeper, so the threads are spread
+    // over two depths instead of all racing on the same one
+    int depthOffset = 0;
+    void startHelpers();
+    // Stops the helpers and adds their nodes to the stats
+    void stopHelpers();
+
+    // Whether every move played since the position was set gave check, so
+    // undoMove() can restore the check counters
+    std::vector<bool> checkHistory;
+
+    std::thread searchThread;
+    std::chrono::steady_clock::time_point backgroundStart;
+    // Published by the search thread at every clock check
+    std::atomic<U64> progressNodes{0};
+    std::atomic<int> progressDepth{0};
+    // Depth of the current search, to tell the ply of a node
+    int rootDepth = 0;
+
+    // Best move of the previous iteration, searched first at the root
+    uint16_t rootBestMove = 0xffff;
+
+    /**
+     * Triangular table of principal variations: pv[ply] is the best line
+     * found from the node at ply, pvLength[ply] where it ends.
+     */
+    uint16_t pv[MAX_SEARCH_DEPTH + 1][MAX_SEARCH_DEPTH + 1];
+    int pvLength[MAX_SEARCH_DEPTH + 1];
+    void updatePv(int ply, uint16_t move);
+
+    // Thinking lines are formatted here, and the string keeps its capacity,
+    // so printing them does not allocate once the first one is sent
+    std::function<void(const std::string&)> thinkingOutput;
+    bool uciOutput = false;
+    char thinkingLine[THINKING_LINE_SIZE];
+    std::string thinkingText;
+    void printThinking(int depth, int score);
+
+    // Time management of think(): no new iteration starts after softLimit,
+    // and the search stops at hardLimit (seconds since searchStart)
+    bool timed = false;
+    bool stopped = false;
+    // Node limit of think(), 0 for none
+    U64 nodeLimit = 0;
+    // Set from another thread to stop the search at the next clock check
+    std::atomic<bool> stopRequested{false};
+    double softLimit = 0, hardLimit = 0;
+    std::chrono::steady_clock::time_point searchStart;
+
+    void allocateTime(const SearchLimits& limits);
+    double elapsed();
+    // Stops the search once the hard limit has passed
+    bool outOfTime();
+
     int alphaBetaMax(int alpha, int beta, int depthleft, uint16_t *move);
     int alphaBetaMin(int alpha, int beta, int depthleft, uint16_t *move);
 };
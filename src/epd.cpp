@@ -0,0 +1,262 @@
+/* Copyright 2021 DucaPowr Team */
+#include "./epd.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "./engine.h"
+#include "./threadPool.h"
+
+struct EpdPosition {
+    std::string fen;
+    std::string id;
+    // Best moves and moves to avoid, in SAN
+    std::vector<std::string> bestMoves;
+    std::vector<std::string> avoidMoves;
+};
+
+struct EpdResult {
+    // False if the position or one of its moves could not be read
+    bool valid = false;
+    std::string move;
+    bool solved = false;
+    // Seconds until the solution was found for good, -1 if never
+    double solveTime = -1;
+    U64 nodes = 0;
+    int depth = 0;
+};
+
+/**
+ * Reads the operations of an EPD line: "opcode operand ...;" groups.
+ * Quoted operands may contain spaces and semicolons.
+ */
+static void parseOperations(const std::string& ops, EpdPosition *pos) {
+    size_t i = 0;
+    while (i < ops.size()) {
+        std::vector<std::string> tokens;
+        std::string token;
+        bool quoted = false;
+
+        for (; i < ops.size() && (quoted || ops[i] != ';'); i++) {
+            if (ops[i] == '"') {
+                quoted = !quoted;
+            } else if (!quoted && isspace(ops[i])) {
+                if (!token.empty()) {
+                    tokens.push_back(token);
+                    token.clear();
+                }
+            } else {
+                token += ops[i];
+            }
+        }
+        if (!token.empty()) {
+            tokens.push_back(token);
+        }
+        // Skip the ';'
+        i++;
+
+        if (tokens.empty()) {
+            continue;
+        }
+
+        if (tokens[0] == "bm") {
+            pos->bestMoves.assign(tokens.begin() + 1, tokens.end());
+        } else if (tokens[0] == "am") {
+            pos->avoidMoves.assign(tokens.begin() + 1, tokens.end());
+        } else if (tokens[0] == "id" && tokens.size() > 1) {
+            pos->id = tokens[1];
+        }
+    }
+}
+
+/**
+ * Whether a token is a 3-check counter field: checks left as "3+3", or
+ * checks given as "+2+0".
+ */
+static bool isCheckField(const std::string& token) {
+    size_t i = token[0] == '+' ? 1 : 0;
+    size_t plus = token.find('+', i);
+    if (plus == std::string::npos || plus == i || plus + 1 == token.size()) {
+        return false;
+    }
+    for (size_t j = i; j < token.size(); j++) {
+        if (j != plus && !isdigit(token[j])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::vector<EpdPosition> loadEpd(std::string fileName) {
+    std::ifstream f(fileName);
+    DIE(!f, "Cannot open the EPD file");
+
+    std::vector<EpdPosition> positions;
+    std::string line;
+    while (std::getline(f, line)) {
+        std::istringstream iss(line);
+        std::string fields[4];
+        if (!(iss >> fields[0] >> fields[1] >> fields[2] >> fields[3])) {
+            continue;
+        }
+
+        EpdPosition pos;
+        // EPD has no move counters
+        pos.fen = fields[0] + ' ' + fields[1] + ' ' + fields[2] + ' ' +
+            fields[3];
+        pos.id = "#" + std::to_string(positions.size() + 1);
+
+        std::string ops;
+        std::getline(iss, ops);
+
+        // The check counters may come before the operations, in either of
+        // the forms setFromFEN() reads
+        size_t begin = ops.find_first_not_of(" \t");
+        size_t end = ops.find_first_of(" \t;", begin);
+        std::string counters = begin == std::string::npos ? "" :
+            ops.substr(begin, end - begin);
+        if (!counters.empty() && isCheckField(counters)) {
+            pos.fen += counters[0] == '+' ? " 0 1 " + counters :
+                ' ' + counters + " 0 1";
+            ops.erase(0, end);
+        } else {
+            pos.fen += " 0 1";
+        }
+        parseOperations(ops, &pos);
+
+        positions.push_back(pos);
+    }
+
+    return positions;
+}
+
+/**
+ * Reads a list of SAN moves.
+ * @return Returns false if one of them is not a legal move.
+ */
+static bool parseMoves(Engine& engine, const std::vector<std::string>& san,
+        std::vector<uint16_t> *moves) {
+    for (const std::string& s : san) {
+        uint16_t move = engine.parseSan(s);
+        if (move == 0xffff) {
+            return false;
+        }
+        moves->push_back(move);
+    }
+    return true;
+}
+
+static void solve(Engine& engine, const EpdPosition& pos, int maxDepth,
+        double seconds, EpdResult *result) {
+    std::vector<uint16_t> bestMoves, avoidMoves;
+    // Without bm or am any move would count as solved
+    if ((pos.bestMoves.empty() && pos.avoidMoves.empty()) ||
+            !engine.setPosition(pos.fen) ||
+            !parseMoves(engine, pos.bestMoves, &bestMoves) ||
+            !parseMoves(engine, pos.avoidMoves, &avoidMoves)) {
+        return;
+    }
+    result->valid = true;
+    // Every position is solved on its own, whatever the worker did before
+    engine.clearHash();
+
+    // The clock stops the iteration it runs out in, which is thrown away
+    SearchLimits limits;
+    limits.depth = maxDepth;
+    limits.moveTime = seconds;
+    engine.think(limits);
+
+    const SearchStats& stats = engine.searchStats();
+    result->nodes = stats.nodes;
+    result->depth = stats.depth;
+
+    auto has = [](const std::vector<uint16_t>& moves, uint16_t move) {
+        return std::find(moves.begin(), moves.end(), move) != moves.end();
+    };
+    double elapsed = 0;
+    for (int depth = 1; depth <= stats.depth; depth++) {
+        uint16_t move = stats.iterationMoves[depth];
+        elapsed += stats.iterationSeconds[depth];
+        result->move = move == 0xffff ? "none" : engine.moveToSan(move);
+        result->solved = move != 0xffff &&
+            (bestMoves.empty() || has(bestMoves, move)) &&
+            !has(avoidMoves, move);
+
+        if (!result->solved) {
+            result->solveTime = -1;
+        } else if (result->solveTime < 0) {
+            result->solveTime = elapsed;
+        }
+    }
+}
+
+void runEpd(std::string fileName, int maxDepth, double seconds,
+        unsigned int threads, std::ostream& out) {
+    std::vector<EpdPosition> positions = loadEpd(fileName);
+    std::vector<EpdResult> results(positions.size());
+
+    auto start = std::chrono::steady_clock::now();
+
+    {
+        ThreadPool pool(threads);
+        std::vector<std::unique_ptr<Engine>> engines(pool.size());
+
+        for (size_t i = 0; i < positions.size(); i++) {
+            pool.submit([&, i](unsigned int index) {
+                // Only this thread ever touches engines[index]
+                if (!engines[index]) {
+                    engines[index].reset(new Engine());
+                    engines[index]->newGame();
+                }
+
+                solve(*engines[index], positions[i], maxDepth, seconds,
+                    &results[i]);
+            });
+        }
+
+        pool.wait();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double totalSeconds = std::chrono::duration<double>(end - start).count();
+
+    size_t solved = 0, valid = 0;
+    U64 nodes = 0;
+    double solveTime = 0;
+
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < positions.size(); i++) {
+        const EpdResult& r = results[i];
+        out << positions[i].id << ' ';
+
+        if (!r.valid) {
+            out << "invalid position, move or no bm/am\n";
+            continue;
+        }
+
+        out << r.move << ' ' << (r.solved ? "solved" : "failed") <<
+            " depth " << r.depth << " nodes " << r.nodes;
+        if (r.solved) {
+            out << " time " << r.solveTime << " s";
+            solved++;
+            solveTime += r.solveTime;
+        }
+        out << '\n';
+
+        valid++;
+        nodes += r.nodes;
+    }
+
+    out << "Solved: " << solved << '/' << valid << '\n';
+    out << "Time to solution: " << solveTime << " s\n";
+    out << "Nodes: " << nodes << '\n';
+    out << "Time: " << totalSeconds << " s\n";
+    out << "NPS: " << static_cast<U64>(nodes / std::max(totalSeconds, 1e-9)) <<
+        std::endl;
+}
@@ -0,0 +1,25 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include <ostream>
+#include <string>
+
+/**
+ * Runs a test suite of EPD positions with "bm" (best move) and/or "am"
+ * (avoid move) operations. A position is solved when the engine plays one of
+ * the best moves and none of the moves to avoid; lines with neither are
+ * reported as invalid. The 3-check counters may follow the en passant
+ * field, as "3+3" (checks left) or "+2+0" (checks given).
+ *
+ * Every position is searched by iterative deepening up to maxDepth, within
+ * the time limit: the depth the clock stops is thrown away, as in a game.
+ * The time to solution is the search time at the end of the first depth
+ * from which the engine kept playing a solving move.
+ *
+ * @param maxDepth the deepest search, in plies
+ * @param seconds the time limit of a position, 0 for none
+ * @param threads the number of positions searched at once, 0 for all
+ * hardware threads
+ */
+void runEpd(std::string fileName, int maxDepth, double seconds,
+    unsigned int threads, std::ostream& out);
@@ -0,0 +1,51 @@
+/* Copyright 2021 DucaPowr Team */
+#include "./evalParams.h"
+
+#include <cstring>
+
+#include "./constants.h"
+
+EvalParams evalParams;
+
+// Fills the block before main() runs
+static struct EvalParamsInit {
+    EvalParamsInit() {
+        resetEvalParams();
+    }
+} evalParamsInit;
+
+void resetEvalParams(void) {
+    EvalParams& p = evalParams;
+
+    p.pawnValueMg = PawnValueMg;
+    p.pawnValueEg = PawnValueEg;
+    p.knightValueMg = KnightValueMg;
+    p.knightValueEg = KnightValueEg;
+    p.bishopValueMg = BishopValueMg;
+    p.bishopValueEg = BishopValueEg;
+    p.rookValueMg = RookValueMg;
+    p.rookValueEg = RookValueEg;
+    p.queenValueMg = QueenValueMg;
+    p.queenValueEg = QueenValueEg;
+
+    p.checkCountValue = CheckCountValue;
+
+    p.kingFriendsValueMg = KingFriendsValueMg;
+    p.kingFriendsValueEg = KingFriendsValueEg;
+
+    p.knightCheckValue = KnightCheckValue;
+    p.bishopCheckValue = BishopCheckValue;
+    p.rookCheckValue = RookCheckValue;
+    p.queenCheckValue = QueenCheckValue;
+    p.kingZoneAttackValue = KingZoneAttackValue;
+
+    const int *mgTables[6] = {mg_pawn_table, mg_bishop_table,
+        mg_knight_table, mg_rook_table, mg_queen_table, mg_king_table};
+    const int *egTables[6] = {eg_pawn_table, eg_bishop_table,
+        eg_knight_table, eg_rook_table, eg_queen_table, eg_king_table};
+
+    for (int i = 0; i < 6; i++) {
+        memcpy(p.mgTables[i], mgTables[i], sizeof(p.mgTables[i]));
+        memcpy(p.egTables[i], egTables[i], sizeof(p.egTables[i]));
+    }
+}
@@ -0,0 +1,40 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+/**
+ * Runtime copy of the eval weights from evalConstants.h, read by
+ * Board::eval(). The tuner changes it between evaluations, so it does not
+ * need to recompile the engine for every step.
+ *
+ * Only ints are allowed in here: the tuner walks the block as a flat array.
+ */
+struct EvalParams {
+    int pawnValueMg, pawnValueEg;
+    int knightValueMg, knightValueEg;
+    int bishopValueMg, bishopValueEg;
+    int rookValueMg, rookValueEg;
+    int queenValueMg, queenValueEg;
+
+    int checkCountValue;
+
+    int kingFriendsValueMg;
+    int kingFriendsValueEg;
+
+    int knightCheckValue;
+    int bishopCheckValue;
+    int rookCheckValue;
+    int queenCheckValue;
+    int kingZoneAttackValue;
+
+    // Piece-square tables, indexed in the same order as enumPiece (without
+    // the colours), from white's point of view
+    int mgTables[6][64];
+    int egTables[6][64];
+};
+
+#define EVAL_PARAMS_COUNT (sizeof(EvalParams) / sizeof(int))
+
+extern EvalParams evalParams;
+
+// Resets evalParams to the values in evalConstants.h
+void resetEvalParams(void);
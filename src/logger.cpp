@@ -1,39 +1,186 @@
 /* Copyright 2021 DucaPowr Team */
 #include "./logger.h"
 
-void Logger::raw(std::string msg) {
-    debugFile << msg << std::endl;
-}
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
 
-void Logger::log(std::string msg, std::string type) {
-    debugFile << '[' << type << ']' << " -> " << msg << std::endl;
-}
+// Records the ring buffer holds, a power of 2
+#define LOG_QUEUE_SIZE 1024
+// How long the writer sleeps when there is nothing to write
+#define LOG_IDLE_MS 5
+
+/**
+ * Bounded multi-producer queue (Vyukov): every cell has a sequence number
+ * that tells whether it is free for the producer of a given position or
+ * holds the record for the consumer of that position.
+ */
+class LogQueue {
+ public:
+    LogQueue() {
+        for (size_t i = 0; i < LOG_QUEUE_SIZE; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~LogQueue() {
+        stop();
+    }
+
+    bool push(int level, std::string& msg) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+
+        while (true) {
+            cell = &cells[pos & (LOG_QUEUE_SIZE - 1)];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // Full
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->level = level;
+        cell->text = std::move(msg);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Only the writer thread pops
+    bool pop(int *level, std::string *msg) {
+        Cell *cell = &cells[dequeuePos & (LOG_QUEUE_SIZE - 1)];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        if (seq != dequeuePos + 1) {
+            return false;
+        }
+
+        *level = cell->level;
+        *msg = std::move(cell->text);
+        cell->sequence.store(dequeuePos + LOG_QUEUE_SIZE,
+            std::memory_order_release);
+        dequeuePos++;
+
+        return true;
+    }
+
+    void write(int level, std::string& msg) {
+        if (!running.load(std::memory_order_acquire)) {
+            start();
+        }
+
+        if (!push(level, msg)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void stop(void) {
+        std::lock_guard<std::mutex> lock(threadMutex);
+        if (!writer.joinable()) {
+            return;
+        }
+
+        stopping = true;
+        writer.join();
+        stopping = false;
+        running.store(false, std::memory_order_release);
+    }
+
+ private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        int level;
+        std::string text;
+    };
+
+    Cell cells[LOG_QUEUE_SIZE];
+    std::atomic<size_t> enqueuePos{0};
+    size_t dequeuePos = 0;
+    std::atomic<uint64_t> dropped{0};
+
+    std::mutex threadMutex;
+    std::thread writer;
+    std::atomic<bool> running{false};
+    std::atomic<bool> stopping{false};
+
+    void start(void) {
+        std::lock_guard<std::mutex> lock(threadMutex);
+        if (!writer.joinable()) {
+            writer = std::thread(&LogQueue::writerLoop, this);
+            running.store(true, std::memory_order_release);
+        }
+    }
+
+    void writerLoop(void) {
+        static const char *levelNames[] = {"DEBUG", "INFO", "ERROR"};
+        int level;
+        std::string msg;
+
+        while (true) {
+            // Read the flag first, so nothing queued before stop() is lost
+            bool last = stopping.load(std::memory_order_acquire);
+            bool wrote = false;
 
-void Logger::info(std::string msg) {
-    log(msg, "INFO");
+            while (pop(&level, &msg)) {
+                Logger::debugFile << '[' << levelNames[level] << "] -> " <<
+                    msg << '\n';
+                wrote = true;
+            }
+
+            uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+            if (lost) {
+                Logger::debugFile << "[ERROR] -> " << lost <<
+                    " log records dropped\n";
+                wrote = true;
+            }
+
+            // One flush per burst of records
+            if (wrote) {
+                Logger::debugFile.flush();
+            }
+
+            if (last) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(LOG_IDLE_MS));
+        }
+    }
+};
+
+/**
+ * Built on first use, after debugFile, so it is destroyed (and drained)
+ * before debugFile is closed.
+ */
+static LogQueue& logQueue(void) {
+    static LogQueue queue;
+    return queue;
 }
 
-void Logger::error(std::string msg) {
-    log(msg, "ERROR");
+void Logger::write(int level, std::string msg) {
+    logQueue().write(level, msg);
 }
 
-void Logger::logU16(uint16_t x) {
-    debugFile << "[INFO] -> " << x << std::endl;
+void Logger::stop(void) {
+    logQueue().stop();
 }
 
-void Logger::logBB(uint64_t a) {
+std::string Logger::bbToString(uint64_t a) {
+    std::string out;
     for (int i = 7; i >= 0; i--) {
-        uint64_t mask = 1;
-        mask <<= i * 8;
         for (int j = 0; j < 8; j++) {
-            if (mask & a) {
-                debugFile << "1";
-            } else {
-                debugFile << "0";
-            }
-            mask <<= 1;
+            out += (a >> (i * 8 + j)) & 1 ? '1' : '0';
         }
-        debugFile << '\n';
+        out += '\n';
     }
-    debugFile << '\n';
+    return out;
 }
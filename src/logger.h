@@ -3,18 +3,63 @@
 
 #define DEBUG 0
 
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_ERROR 2
+#define LOG_LEVEL_NONE 3
+
+/**
+ * Records below LOG_LEVEL compile to nothing, their message is not even
+ * built. Set it at build time, eg: make build DEBUG=-DLOG_LEVEL=3
+ */
+#ifndef LOG_LEVEL
+#if DEBUG
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#else
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
 #include <stdint.h>
 #include <fstream>
-#include <bitset>
 #include <string>
+
+/**
+ * The message is only evaluated when its level is compiled in. It can be any
+ * expression that makes a std::string.
+ */
+#define LOG_AT(level, msg) \
+    do { \
+        if ((level) >= LOG_LEVEL) { \
+            Logger::write((level), (msg)); \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(msg) LOG_AT(LOG_LEVEL_DEBUG, msg)
+#define LOG_INFO(msg) LOG_AT(LOG_LEVEL_INFO, msg)
+#define LOG_ERROR(msg) LOG_AT(LOG_LEVEL_ERROR, msg)
+
+/**
+ * Writes records to debugFile from a background thread. write() only moves
+ * the message into a lock-free ring buffer, so logging never waits for the
+ * disk. When the buffer is full the record is dropped and counted.
+ */
 class Logger {
  public:
     static std::ofstream debugFile;
 
-    void raw(std::string msg);
-    void log(std::string msg, std::string type);
-    void info(std::string msg);
-    void error(std::string msg);
-    void logU16(uint16_t x);
-    void logBB(uint64_t x);
+    /**
+     * Queues a record. Prefer the LOG_* macros, which skip the call (and
+     * building the message) below LOG_LEVEL.
+     */
+    static void write(int level, std::string msg);
+
+    /**
+     * Writes every queued record and stops the background thread. Records
+     * logged later are written by a new thread.
+     */
+    static void stop(void);
+
+    // An 8x8 picture of a bitboard, rank 8 first
+    static std::string bbToString(uint64_t x);
 };
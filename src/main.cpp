@@ -1,26 +1,114 @@
 /* Copyright 2021 DucaPowr Team */
+#include <cstring>
 #include <iostream>
 #include <string>
 
 #include "./engine.h"
+#include "./uciHandler.h"
 #include "./xboardHandler.h"
 #include "./logger.h"
 #include "./config.h"
+#include "./bench.h"
+#include "./book.h"
+#include "./constants.h"
+#include "./endgame.h"
+#include "./epd.h"
+#include "./nnue.h"
+#include "./server.h"
+#include "./tablebase.h"
 
 // init debug file
 std::ofstream Logger::debugFile(DEBUG_FILE_NAME);
 
-// main
-int main(void) {
+/**
+ * Usage:
+ * ./duca               - xboard or UCI engine, after the first command
+ * ./duca perft <depth> [threads]  - perft from the initial position
+ * ./duca divide <depth> [threads] - perft with the node count of every root
+ *                                   move
+ * ./duca bench [depth] [threads]  - search a fixed set of positions and
+ *                                   print the node count and the speed
+ * ./duca epd <file> [max depth] [seconds] [threads]
+ *                                 - run an EPD test suite
+ * ./duca server <socket> [workers] [hash MB]
+ *                                 - play the games of every client of a
+ *                                   Unix domain socket, see server.h
+ */
+int main(int argc, char **argv) {
+    Endgame::init();
+
+    // The node count of the bench must not depend on the network or the
+    // tables of the working directory, so it runs without them
+    if (argc >= 2 && !strcmp(argv[1], "bench")) {
+        runBench(argc >= 3 ? atoi(argv[2]) : BENCH_DEPTH,
+            argc >= 4 ? atoi(argv[3]) : 0, std::cout);
+        return 0;
+    }
+
+    // Without a weights file the hand-crafted eval is used
+    if (Network::load(NNUE_FILE)) {
+        LOG_INFO("Loaded network from " + std::string(NNUE_FILE));
+    }
+    int tables = Tablebases::open(TABLEBASE_DIR);
+    if (tables > 0) {
+        LOG_INFO("Opened " + std::to_string(tables) + " endgame tables");
+    }
+    // Without a book every move is searched
+    if (Book::open(BOOK_FILE)) {
+        LOG_INFO("Opened book " + std::string(BOOK_FILE));
+    }
+
+    if (argc >= 3 && !strcmp(argv[1], "server")) {
+        Server server(argv[2], argc >= 4 ? atoi(argv[3]) : 0,
+            argc >= 5 ? atoi(argv[4]) : SERVER_HASH_MB);
+        if (!server.run()) {
+            std::cerr << "Cannot listen on " << argv[2] << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
     Engine engine;
-    xBoardHandler handler(engine);
 
-    handler.init();
+    if (argc >= 3 && (!strcmp(argv[1], "perft") ||
+            !strcmp(argv[1], "divide"))) {
+        engine.newGame();
+        engine.perftReport(atoi(argv[2]), !strcmp(argv[1], "divide"),
+            argc >= 4 ? atoi(argv[3]) : 0, std::cout);
+        return 0;
+    }
+
+    if (argc >= 3 && !strcmp(argv[1], "epd")) {
+        runEpd(argv[2], argc >= 4 ? atoi(argv[3]) : EPD_DEPTH,
+            argc >= 5 ? atof(argv[4]) : 0, argc >= 6 ? atoi(argv[5]) : 0,
+            std::cout);
+        return 0;
+    }
+
+    // The first command picks the protocol
+    std::string firstCommand;
+    std::getline(std::cin, firstCommand);
+    LOG_INFO("first command " + firstCommand);
+
+    if (firstCommand == "uci") {
+        UciHandler handler(engine);
+        handler.init();
+
+        while (engine.isRunning()) {
+            handler.run();
+        }
+    } else {
+        xBoardHandler handler(engine);
+        handler.init(firstCommand);
 
-    while (engine.isRunning()) {
-        handler.run();
+        while (engine.isRunning()) {
+            handler.run();
+        }
     }
 
+    Book::close();
+    Tablebases::close();
+    Logger::stop();
     (Logger::debugFile).close();
 
     return 0;
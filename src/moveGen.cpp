@@ -6,21 +6,33 @@
 #include "logger.h"
 #include <bits/stdint-uintn.h>
 #include <cstdio>
+#include <mutex>
 #include <string>
 #include <vector>
 
+U64 Generator::firstRankAttacks[64][8];
+U64 Generator::firstFileAttacks[64][8];
+U64 Generator::bishopAttackTable[64][512];
+U64 Generator::bishopMask[64];
+U64 Generator::ascDiagMask[15];
+U64 Generator::desDiagMask[15];
+U64 Generator::kingNeighbors[64];
+U64 Generator::knightPosMoves[64];
+
 Generator::Generator(Board& board) : _board(board) {
-    initFirstRankAttacks();
-    initFirstFileAttacks();
-    initKingNeighbors();
-    initDiagMasks();
-    initBishopMask();
-    initBishopAttackTable();
-    initKnightPosMoves();
-
-    if (DEBUG) {
-        _logger.info("Finished initialising the Generator");
-    }
+    // Built once, later generators only keep a reference to their board
+    static std::once_flag tablesReady;
+    std::call_once(tablesReady, [this]() {
+        initFirstRankAttacks();
+        initFirstFileAttacks();
+        initKingNeighbors();
+        initDiagMasks();
+        initBishopMask();
+        initBishopAttackTable();
+        initKnightPosMoves();
+
+        LOG_DEBUG("Finished initialising the Generator");
+    });
 }
 
 /**
@@ -375,84 +387,79 @@ U64 Generator::getQueenAttackBB(Side side) {
 }
 
 U64 Generator::getWhitePawnAttackBB() {
-    U64 opponentBB = _board.getPieceBB(blackSide);
-    U64 enPassantablePawns = _board.getEnPassantablePawnsBB(blackSide);
     U64 pawnBB = _board.getPawnBB(whiteSide);
-    U64 leftAttacks;
-    U64 rightAttacks;
-    U64 leftPromotions;
-    U64 rightPromotions;
-    U64 leftEnPassant;
-    U64 rightEnPassant;
-    U64 allAttacksBB = 0;
-
-    leftAttacks = (pawnBB << 7) & (~HFILE) & opponentBB & (~RANK8);
-    rightAttacks = (pawnBB << 9) & (~AFILE) & opponentBB & (~RANK8);
-    leftPromotions = (pawnBB << 7) & (~HFILE) & opponentBB & RANK8;
-    rightPromotions = (pawnBB << 9) & (~AFILE) & opponentBB & RANK8;
-    leftEnPassant = (pawnBB >> 1) & (~HFILE) & enPassantablePawns;
-    leftEnPassant <<= 8;
-    rightEnPassant = (pawnBB << 1) & (~AFILE) & enPassantablePawns;
-    rightEnPassant <<= 8;
-
 
-    allAttacksBB |= leftAttacks;
-    allAttacksBB |= rightAttacks;
-    allAttacksBB |= leftPromotions;
-    allAttacksBB |= rightPromotions;
-    allAttacksBB |= leftEnPassant;
-    allAttacksBB |= rightEnPassant;
-
-    return allAttacksBB;
+    // Every square a pawn could capture on, occupied or not, so that the
+    // attack map also covers the empty squares a king has to cross
+    return ((pawnBB << 7) & (~HFILE)) | ((pawnBB << 9) & (~AFILE));
 }
 
 U64 Generator::getBlackPawnAttackBB() {
-    U64 opponentBB = _board.getPieceBB(whiteSide);
-    U64 enPassantablePawns = _board.getEnPassantablePawnsBB(whiteSide);
     U64 pawnBB = _board.getPawnBB(blackSide);
-    U64 leftAttacks;
-    U64 rightAttacks;
-    U64 leftPromotions;
-    U64 rightPromotions;
-    U64 leftEnPassant;
-    U64 rightEnPassant;
-    U64 allAttacksBB = 0;
-
-    leftAttacks = (pawnBB >> 9) & (~HFILE) & opponentBB & (~RANK1);
-    rightAttacks = (pawnBB >> 7) & (~AFILE) & opponentBB & (~RANK1);
-    leftPromotions = (pawnBB >> 9) & (~HFILE) & opponentBB & RANK1;
-    rightPromotions = (pawnBB >> 7) & (~AFILE) & opponentBB & RANK1;
-    leftEnPassant = (pawnBB >> 1) & (~HFILE) & enPassantablePawns;
-    leftEnPassant >>= 8;
-    rightEnPassant = (pawnBB << 1) & (~AFILE) & enPassantablePawns;
-    rightEnPassant >>= 8;
-
-    allAttacksBB |= leftAttacks;
-    allAttacksBB |= rightAttacks;
-    allAttacksBB |= leftPromotions;
-    allAttacksBB |= rightPromotions;
-    allAttacksBB |= leftEnPassant;
-    allAttacksBB |= rightAttacks;
-    allAttacksBB |= rightEnPassant;
 
-    return allAttacksBB;
+    return ((pawnBB >> 9) & (~HFILE)) | ((pawnBB >> 7) & (~AFILE));
 }
 
 U64 Generator::getAttackBB(Side side) {
-    U64 attackBB = 0;
+    AttackCache &cache = _board.attackCache[side];
 
-    attackBB |= getRookAttackBB(side);
-    attackBB |= getBishopAttackBB(side);
-    attackBB |= getKnightAttackBB(side);
-    attackBB |= getQueenAttackBB(side);
+    cache.rook = getRookAttackBB(side);
+    cache.bishop = getBishopAttackBB(side);
+    cache.knight = getKnightAttackBB(side);
+    cache.queen = getQueenAttackBB(side);
 
     if (side == whiteSide) {
-        attackBB |= getWhitePawnAttackBB();
+        cache.pawn = getWhitePawnAttackBB();
     } else {
-        attackBB |= getBlackPawnAttackBB();
+        cache.pawn = getBlackPawnAttackBB();
+    }
+
+    cache.all = cache.rook | cache.bishop | cache.knight | cache.queen |
+        cache.pawn;
+
+    // The king cannot give check, but it keeps the other king away
+    U64 kingBB = _board.getKingBB(side);
+    if (kingBB) {
+        cache.all |= kingNeighbors[getSquareIndex(kingBB)];
     }
 
-    return attackBB;
+    initCheckSquares(side);
+    cache.valid = true;
+
+    return cache.all;
+}
+
+void Generator::initCheckSquares(Side side) {
+    AttackCache &cache = _board.attackCache[side];
+    U64 kingBB = _board.getKingBB(otherSide(side));
+
+    if (!kingBB) {
+        cache.kingZone = 0;
+        cache.knightChecks = 0;
+        cache.bishopChecks = 0;
+        cache.rookChecks = 0;
+        return;
+    }
+
+    uint16_t kingIndex = getSquareIndex(kingBB);
+    uint16_t rank = kingIndex / 8;
+    uint16_t file = kingIndex % 8;
+    U64 occ = _board.getAllBB() & (~kingBB);
+
+    cache.kingZone = kingNeighbors[kingIndex];
+
+    // A knight checks the king from the squares a knight on the king square
+    // would attack, and the same goes for the sliders.
+    cache.knightChecks = knightPosMoves[kingIndex];
+
+    U64 bishopOcc = bishopMask[kingIndex] & occ;
+    bishopOcc = (bishopOcc * bishopMagics[kingIndex]) >>
+        (64 - bishopRelevantBits[kingIndex]);
+    bishopOcc &= (1 << bishopRelevantBits[kingIndex]) - 1;
+    cache.bishopChecks = bishopAttackTable[kingIndex][bishopOcc];
+
+    cache.rookChecks = getRookRankAttackBB(rank, file, occ, 0) |
+        getRookFileAttackBB(rank, file, occ, 0);
 }
 
 void Generator::generateMoves(uint16_t* attacks, uint16_t* attacksLen) {
@@ -483,6 +490,19 @@ void Generator::generateMoves(uint16_t* attacks, uint16_t* attacksLen) {
     *attacksLen += movesLen;
 }
 
+void Generator::addPromotions(uint16_t move, uint16_t* moves,
+        uint16_t* len) {
+    // Set promotion flag
+    move |= 0x4000;
+
+    // Queen first, as it is almost always the best one, then knight, rook
+    // and bishop
+    moves[(*len)++] = move | 0x3000;
+    moves[(*len)++] = move | 0x1000;
+    moves[(*len)++] = move;
+    moves[(*len)++] = move | 0x2000;
+}
+
 void Generator::whitePawnMoves(uint16_t* moves, uint16_t *len) {
     uint64_t emptyPiece = _board.getEmptyBB();
     uint64_t possibleMoves;
@@ -510,18 +530,7 @@ void Generator::whitePawnMoves(uint16_t* moves, uint16_t *len) {
         tmp = tmp << 6;
         tmp |= getSquareIndex(dst >> 8);
 
-        // Set promotion flag
-        tmp |= 0x4000;
-
-        // Set bits for queen promotion
-        tmp |= 0x3000;
-        moves[(*len)++] = tmp;
-
-        // Switch the promotion bits back to 0
-        tmp ^= 0x3000;
-        // Set bits for knight promotion
-        tmp |= 0x1000;
-        moves[(*len)++] = tmp;
+        addPromotions(tmp, moves, len);
     }
 
     separated = getSeparatedBits(possibleMovesJump);
@@ -564,18 +573,7 @@ void Generator::blackPawnMoves(uint16_t* moves, uint16_t* len) {
         tmp = tmp << 6;
         tmp |= getSquareIndex(dst << 8);
 
-        // Set promotion flag
-        tmp |= 0x4000;
-
-        // Set bits for queen promotion
-        tmp |= 0x3000;
-        moves[(*len)++] = tmp;
-
-        // Set the promotion bits back to 0
-        tmp ^= 0x3000;
-        // Set bits for knight promotion
-        tmp |= 0x1000;
-        moves[(*len)++] = tmp;
+        addPromotions(tmp, moves, len);
      }
 
     separated = getSeparatedBits(possibleMovesJump);
@@ -640,18 +638,7 @@ void Generator::whitePawnAttacks(uint16_t* moves, uint16_t* len) {
         tmp <<= 6;
         tmp |= getSquareIndex(attackDst >> 7);
 
-        // Set promotion flag
-        tmp |= 0x4000;
-
-        // Set bits for queen promotion
-        tmp |= 0x3000;
-        moves[(*len)++] = tmp;
-
-        // Set the promotion bits back to 0
-        tmp ^= 0x3000;
-        // Set bits for knight promotion
-        tmp |= 0x1000;
-        moves[(*len)++] = tmp;
+        addPromotions(tmp, moves, len);
     }
 
     // Generate a move for every right attack -> promotion
@@ -661,18 +648,7 @@ void Generator::whitePawnAttacks(uint16_t* moves, uint16_t* len) {
         tmp <<= 6;
         tmp |= getSquareIndex(attackDst >> 9);
 
-        // Set promotion flag
-        tmp |= 0x4000;
-
-        // Set bits for queen promotion
-        tmp |= 0x3000;
-        moves[(*len)++] = tmp;
-
-        // Set the promotion bits back to 0
-        tmp ^= 0x3000;
-        // Set bits for knight promotion
-        tmp |= 0x1000;
-        moves[(*len)++] = tmp;
+        addPromotions(tmp, moves, len);
     }
 
     // Generate a move for every left en passant
@@ -745,18 +721,7 @@ void Generator::blackPawnAttacks(uint16_t* moves, uint16_t* len) {
         tmp <<= 6;
         tmp |= getSquareIndex(attackDst << 9);
 
-        // Set promotion flag
-        tmp |= 0x4000;
-
-        // Set bits for queen promotion
-        tmp |= 0x3000;
-        moves[(*len)++] = tmp;
-
-        // Set the promotion bits back to 0
-        tmp ^= 0x3000;
-        // Set bits for knight promotion
-        tmp |= 0x1000;
-        moves[(*len)++] = tmp;
+        addPromotions(tmp, moves, len);
     }
 
     // Generate a move for every right attack -> promotion
@@ -766,18 +731,7 @@ void Generator::blackPawnAttacks(uint16_t* moves, uint16_t* len) {
         tmp <<= 6;
         tmp |= getSquareIndex(attackDst << 7);
 
-        // Set promotion flag
-        tmp |= 0x4000;
-
-        // Set bits for queen promotion
-        tmp |= 0x3000;
-        moves[(*len)++] = tmp;
-
-        // Set the promotion bits back to 0
-        tmp ^= 0x3000;
-        // Set bits for knight promotion
-        tmp |= 0x1000;
-        moves[(*len)++] = tmp;
+        addPromotions(tmp, moves, len);
     }
 
     // Generate a move for every left en passant
@@ -21,13 +21,25 @@ class Generator {
 
     void generateMoves(uint16_t* moves, uint16_t* len);
 
+    /**
+     * @brief Computes the squares attacked by a side. The attack map of each
+     * piece type is also stored in the board's attack cache, for eval().
+     */
     U64 getAttackBB(Side side);
 
+    // Sliding piece lookups, also timed separately by tests/bench
+    U64 getPositionedBishopAttackBB(Side side, U64 bishopBB);
+    U64 getRookFileAttackBB(uint16_t rookRank, uint16_t rookFile,
+            U64 occ, U64 friendPieceBB);
+    U64 getRookRankAttackBB(uint16_t rookRank, uint16_t rookFile,
+            U64 occ, U64 friendPieceBB);
+
     // vvvvv Perhaps these should be private?
-    U64 firstRankAttacks[64][8];
-    U64 firstFileAttacks[64][8];
-    U64 bishopAttackTable[64][512];
-    U64 bishopMask[64];
+    // The tables are shared by every generator, the first one builds them
+    static U64 firstRankAttacks[64][8];
+    static U64 firstFileAttacks[64][8];
+    static U64 bishopAttackTable[64][512];
+    static U64 bishopMask[64];
     /* Masks for the ascending diagonals
      * Where ascDiagMask[0] is a mask for the A8-A8 diagonal
      *   and ascDiag[14]    is a mask for the H1-H1 diagonal.
@@ -42,7 +54,7 @@ class Generator {
      * ....4321
      * ...43210
      */
-    U64 ascDiagMask[15];
+    static U64 ascDiagMask[15];
     /* Masks for the descending diagonals
      * Where desDiagMask[0] is a mask for the A1-A1 diagonal
      *   and ascDiag[14]    is a mask for the H8-H8 diagonal.
@@ -57,7 +69,7 @@ class Generator {
      * 1234....
      * 01234...
      */
-    U64 desDiagMask[15];
+    static U64 desDiagMask[15];
     // ^^^^^ Perhaps these should be private?
 
     /**
@@ -65,14 +77,13 @@ class Generator {
      * might be at, the associated bitboard with all the attack positions
      * marked.
      */
-    U64 kingNeighbors[64];
+    static U64 kingNeighbors[64];
 
  private:
     Board& _board;
-    Logger _logger;
 
     // Bitboards off all possible knight moves from square i, 0 <= i < 64
-    U64 knightPosMoves[64];
+    static U64 knightPosMoves[64];
 
     U8 generateLineAttacks(U8 rook, U8 occ);
     void initFirstRankAttacks();
@@ -88,24 +99,33 @@ class Generator {
     void initPositionedBishopAttackTable(int bishopIndex);
     void initBishopAttackTable();
 
+    /**
+     * @brief Fills in the checking squares and the king zone of the enemy
+     * king in the attack cache of the given side. Called by getAttackBB().
+     */
+    void initCheckSquares(Side side);
+
     U64 getPositionedRookAttackBB(Side side, U64 rookBB);
     U64 getRookAttackBB(Side side);
-    U64 getPositionedBishopAttackBB(Side side, U64 bishopBB);
     U64 getBishopAttackBB(Side side);
     U64 getKnightAttackBB(Side side);
     U64 getQueenAttackBB(Side side);
     U64 getWhitePawnAttackBB();
     U64 getBlackPawnAttackBB();
 
+    /**
+     * @brief Adds a pawn move to the last rank once for every piece the pawn
+     * can promote to.
+     *
+     * @param move the move, without the promotion bits and flag
+     */
+    void addPromotions(uint16_t move, uint16_t* moves, uint16_t* len);
+
     void whitePawnMoves(uint16_t* moves, uint16_t* len);
     void blackPawnMoves(uint16_t* moves, uint16_t* len);
     void whitePawnAttacks(uint16_t* moves, uint16_t* len);
     void blackPawnAttacks(uint16_t* moves, uint16_t* len);
 
-    U64 getRookFileAttackBB(uint16_t rookRank, uint16_t rookFile,
-            U64 occ, U64 friendPieceBB);
-    U64 getRookRankAttackBB(uint16_t rookRank, uint16_t rookFile,
-            U64 occ, U64 friendPieceBB);
     void rookAttacks(uint16_t *moves, uint16_t *moves_len, 
         uint16_t *attacks, uint16_t *attacks_len, U64 rookBB,
         U64 friendPieceBB);
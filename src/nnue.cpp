@@ -0,0 +1,217 @@
+/* Copyright 2021 DucaPowr Team */
+#include "./nnue.h"
+
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define NNUE_MAGIC 0x41435544
+
+bool Network::loaded = false;
+int16_t Network::featureBias[NNUE_HIDDEN];
+int16_t Network::featureWeights[NNUE_INPUTS][NNUE_HIDDEN];
+int8_t Network::outputWeights[2 * NNUE_HIDDEN];
+int32_t Network::outputBias;
+
+bool Network::load(std::string fileName) {
+    std::ifstream f(fileName, std::ios::binary);
+    if (!f) {
+        return false;
+    }
+
+    uint32_t header[3];
+    f.read(reinterpret_cast<char *>(header), sizeof(header));
+    if (!f || header[0] != NNUE_MAGIC || header[1] != NNUE_INPUTS ||
+            header[2] != NNUE_HIDDEN) {
+        return false;
+    }
+
+    f.read(reinterpret_cast<char *>(featureBias), sizeof(featureBias));
+    f.read(reinterpret_cast<char *>(featureWeights), sizeof(featureWeights));
+    f.read(reinterpret_cast<char *>(outputWeights), sizeof(outputWeights));
+    f.read(reinterpret_cast<char *>(&outputBias), sizeof(outputBias));
+
+    loaded = static_cast<bool>(f);
+    return loaded;
+}
+
+void Network::close(void) {
+    loaded = false;
+}
+
+bool Network::isLoaded(void) {
+    return loaded;
+}
+
+int Network::pieceFeature(Side perspective, int piece, int square) {
+    // Note: white pieces have even indexes and black pieces odd ones, see
+    // enumPiece in board.h.
+    int type = piece >> 1;
+    int enemy = (piece & 1) != perspective;
+
+    if (perspective == blackSide) {
+        // Flip the board vertically
+        square ^= 56;
+    }
+
+    return (((type << 1) | enemy) << 6) + square;
+}
+
+int Network::checkFeature(Side perspective, Side side, int count) {
+    // The search can go past the third check, so clamp the counter
+    return NNUE_PIECE_FEATURES + ((side != perspective) << 2) +
+        std::min(count, 3);
+}
+
+void Network::refresh(Accumulator& acc, const U64 *pieceBB,
+        const uint8_t *checkCount) {
+    for (int perspective = whiteSide; perspective <= blackSide;
+            perspective++) {
+        memcpy(acc.acc[perspective], featureBias, sizeof(featureBias));
+    }
+
+    for (int piece = 0; piece < 12; piece++) {
+        U64 bb = pieceBB[piece];
+        while (bb) {
+            addPiece(acc, piece, getSquareIndex(bb));
+            bb &= bb - 1;
+        }
+    }
+
+    for (int perspective = whiteSide; perspective <= blackSide;
+            perspective++) {
+        Side p = (Side) perspective;
+        addWeights(acc.acc[p], featureWeights[checkFeature(p, whiteSide,
+            checkCount[whiteSide])]);
+        addWeights(acc.acc[p], featureWeights[checkFeature(p, blackSide,
+            checkCount[blackSide])]);
+    }
+}
+
+void Network::addPiece(Accumulator& acc, int piece, int square) {
+    addWeights(acc.acc[whiteSide],
+        featureWeights[pieceFeature(whiteSide, piece, square)]);
+    addWeights(acc.acc[blackSide],
+        featureWeights[pieceFeature(blackSide, piece, square)]);
+}
+
+void Network::removePiece(Accumulator& acc, int piece, int square) {
+    subWeights(acc.acc[whiteSide],
+        featureWeights[pieceFeature(whiteSide, piece, square)]);
+    subWeights(acc.acc[blackSide],
+        featureWeights[pieceFeature(blackSide, piece, square)]);
+}
+
+void Network::updateChecks(Accumulator& acc, Side side,
+        int oldCount, int newCount) {
+    for (int perspective = whiteSide; perspective <= blackSide;
+            perspective++) {
+        Side p = (Side) perspective;
+        subWeights(acc.acc[p], featureWeights[checkFeature(p, side,
+            oldCount)]);
+        addWeights(acc.acc[p], featureWeights[checkFeature(p, side,
+            newCount)]);
+    }
+}
+
+int Network::evaluate(const Accumulator& acc, Side side) {
+    int32_t sum = outputBias;
+
+    // The side to move always uses the first half of the output weights
+    sum += outputDot(acc.acc[side], outputWeights);
+    sum += outputDot(acc.acc[otherSide(side)], outputWeights + NNUE_HIDDEN);
+
+    return static_cast<int64_t>(sum) * NNUE_OUTPUT_SCALE /
+        (NNUE_QA * NNUE_QB);
+}
+
+#if defined(__AVX2__)
+
+void Network::addWeights(int16_t *acc, const int16_t *weights) {
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i a = _mm256_load_si256(reinterpret_cast<__m256i *>(acc + i));
+        __m256i w = _mm256_load_si256(
+            reinterpret_cast<const __m256i *>(weights + i));
+        _mm256_store_si256(reinterpret_cast<__m256i *>(acc + i),
+            _mm256_add_epi16(a, w));
+    }
+}
+
+void Network::subWeights(int16_t *acc, const int16_t *weights) {
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i a = _mm256_load_si256(reinterpret_cast<__m256i *>(acc + i));
+        __m256i w = _mm256_load_si256(
+            reinterpret_cast<const __m256i *>(weights + i));
+        _mm256_store_si256(reinterpret_cast<__m256i *>(acc + i),
+            _mm256_sub_epi16(a, w));
+    }
+}
+
+int32_t Network::outputDot(const int16_t *acc, const int8_t *weights) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i qa = _mm256_set1_epi16(NNUE_QA);
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+
+    for (int i = 0; i < NNUE_HIDDEN; i += 32) {
+        // Clipped ReLU on 32 neurons
+        __m256i a0 = _mm256_load_si256(
+            reinterpret_cast<const __m256i *>(acc + i));
+        __m256i a1 = _mm256_load_si256(
+            reinterpret_cast<const __m256i *>(acc + i + 16));
+        a0 = _mm256_min_epi16(_mm256_max_epi16(a0, zero), qa);
+        a1 = _mm256_min_epi16(_mm256_max_epi16(a1, zero), qa);
+
+        // Pack them to 8 bits. The pack works on 128 bit lanes, so the
+        // 64 bit blocks need to be put back in order.
+        __m256i a = _mm256_packus_epi16(a0, a1);
+        a = _mm256_permute4x64_epi64(a, 0xD8);
+
+        __m256i w = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(weights + i));
+
+        // u8 * i8 products, summed in pairs to i16 and then to i32
+        __m256i prod = _mm256_maddubs_epi16(a, w);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(prod, ones));
+    }
+
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum),
+        _mm256_extracti128_si256(sum, 1));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+
+    return _mm_cvtsi128_si32(sum128);
+}
+
+#else
+
+void Network::addWeights(int16_t *acc, const int16_t *weights) {
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        acc[i] += weights[i];
+    }
+}
+
+void Network::subWeights(int16_t *acc, const int16_t *weights) {
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        acc[i] -= weights[i];
+    }
+}
+
+int32_t Network::outputDot(const int16_t *acc, const int8_t *weights) {
+    int32_t sum = 0;
+
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        // Clipped ReLU
+        int32_t a = std::min(std::max(static_cast<int32_t>(acc[i]), 0),
+            NNUE_QA);
+        sum += a * weights[i];
+    }
+
+    return sum;
+}
+
+#endif
@@ -0,0 +1,88 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "./utils.h"
+
+/**
+ * Input features, for each perspective (the side the network "looks" from):
+ * [0..767]   - 12 pieces * 64 squares. Pieces of the perspective side come
+ *              first, and the board is flipped vertically for black.
+ * [768..771] - one-hot number of checks received by the perspective side
+ * [772..775] - one-hot number of checks received by the other side
+*/
+#define NNUE_PIECE_FEATURES 768
+#define NNUE_INPUTS         776
+#define NNUE_HIDDEN         256
+
+// Quantization of the hidden layer activations and of the output weights
+#define NNUE_QA             127
+#define NNUE_QB             64
+// Converts the network output to the units used by Board::eval()
+#define NNUE_OUTPUT_SCALE   600
+
+/**
+ * The first layer of the network, for both perspectives.
+ * acc[side] is the hidden layer as seen by side, before the activation.
+*/
+struct Accumulator {
+    alignas(32) int16_t acc[2][NNUE_HIDDEN];
+};
+
+/**
+ * Optional neural network evaluator, loaded once at startup and shared by
+ * every Board. The hidden layer is kept in an Accumulator that the Board
+ * updates incrementally as pieces move.
+ *
+ * Weights file format (little endian):
+ * uint32 magic ("DUCA"), uint32 inputs, uint32 hidden size,
+ * int16 featureBias[hidden], int16 featureWeights[inputs][hidden],
+ * int8 outputWeights[2 * hidden], int32 outputBias
+*/
+class Network {
+ public:
+    /**
+     * Loads the weights from a file.
+     * @return Returns false if the file is missing or does not match the
+     * network architecture, in which case the network stays disabled.
+    */
+    static bool load(std::string fileName);
+    // Goes back to the hand-crafted eval
+    static void close(void);
+
+    static bool isLoaded(void);
+
+    // Computes the accumulator from scratch.
+    static void refresh(Accumulator& acc, const U64 *pieceBB,
+            const uint8_t *checkCount);
+
+    // Adds or removes a piece (enumPiece index) on a square (0-63).
+    static void addPiece(Accumulator& acc, int piece, int square);
+    static void removePiece(Accumulator& acc, int piece, int square);
+
+    // Updates the check counter features of a side.
+    static void updateChecks(Accumulator& acc, Side side,
+            int oldCount, int newCount);
+
+    /**
+     * @return The score of the position from side's point of view.
+    */
+    static int evaluate(const Accumulator& acc, Side side);
+
+ private:
+    static bool loaded;
+
+    alignas(32) static int16_t featureBias[NNUE_HIDDEN];
+    alignas(32) static int16_t featureWeights[NNUE_INPUTS][NNUE_HIDDEN];
+    alignas(32) static int8_t outputWeights[2 * NNUE_HIDDEN];
+    static int32_t outputBias;
+
+    static int pieceFeature(Side perspective, int piece, int square);
+    static int checkFeature(Side perspective, Side side, int count);
+
+    static void addWeights(int16_t *acc, const int16_t *weights);
+    static void subWeights(int16_t *acc, const int16_t *weights);
+    static int32_t outputDot(const int16_t *acc, const int8_t *weights);
+};
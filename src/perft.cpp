@@ -0,0 +1,197 @@
+/* Copyright 2021 DucaPowr Team */
+#include "./perft.h"
+
+#include "./constants.h"
+#include "./threadPool.h"
+
+PerftTable::PerftTable(size_t sizeMB) {
+    size_t count = 1;
+    while (count * 2 * sizeof(Entry) <= (sizeMB << 20)) {
+        count *= 2;
+    }
+
+    entries.reset(new Entry[count]);
+    for (size_t i = 0; i < count; i++) {
+        entries[i].check.store(0, std::memory_order_relaxed);
+        entries[i].data.store(0, std::memory_order_relaxed);
+    }
+    mask = count - 1;
+}
+
+bool PerftTable::probe(U64 key, int depth, U64 *count) {
+    Entry& entry = entries[key & mask];
+    U64 data = entry.data.load(std::memory_order_relaxed);
+    U64 check = entry.check.load(std::memory_order_relaxed);
+
+    if ((check ^ data) != key || static_cast<int>(data & 0xFF) != depth) {
+        return false;
+    }
+
+    *count = data >> 8;
+    return true;
+}
+
+void PerftTable::store(U64 key, int depth, U64 count) {
+    Entry& entry = entries[key & mask];
+    U64 data = (count << 8) | depth;
+
+    entry.check.store(key ^ data, std::memory_order_relaxed);
+    entry.data.store(data, std::memory_order_relaxed);
+}
+
+Perft::Perft(Board& board, Generator& generator, MoveChecker& checker,
+        PerftTable *table) : _board(board), _generator(generator),
+        _checker(checker), _table(table) {}
+
+void Perft::legalMoves(uint16_t *moves, uint16_t *movesLen) {
+    uint16_t pseudoLegal[MAX_MOVES_AT_STEP];
+    uint16_t pseudoLegalLen = 0;
+    _generator.generateMoves(pseudoLegal, &pseudoLegalLen);
+    U64 attackBB = _generator.getAttackBB(otherSide(_board.sideToMove));
+
+    *movesLen = 0;
+    for (int i = 0; i < pseudoLegalLen; ++i) {
+        if (!_checker.isLegal(pseudoLegal[i], attackBB))
+            continue;
+
+        _board.applyMove(pseudoLegal[i]);
+        if (!_checker.IamInCheck(_generator.getAttackBB(_board.sideToMove))) {
+            moves[(*movesLen)++] = pseudoLegal[i];
+        }
+        _board.undoMove();
+    }
+}
+
+U64 Perft::run(int depth) {
+    if (depth == 0) {
+        return 1;
+    }
+
+    U64 key = 0;
+    U64 nodes = 0;
+    bool hashed = _table != NULL && depth >= 2;
+    if (hashed) {
+        key = _board.hash();
+        if (_table->probe(key, depth, &nodes)) {
+            return nodes;
+        }
+    }
+
+    uint16_t moves[MAX_MOVES_AT_STEP];
+    uint16_t movesLen = 0;
+    _generator.generateMoves(moves, &movesLen);
+    U64 attackBB = _generator.getAttackBB(otherSide(_board.sideToMove));
+
+    for (int i = 0; i < movesLen; ++i) {
+        if (!_checker.isLegal(moves[i], attackBB))
+            continue;
+
+        _board.applyMove(moves[i]);
+        if (_checker.IamInCheck(_generator.getAttackBB(_board.sideToMove))) {
+            _board.undoMove();
+            continue;
+        }
+
+        // Bulk counting: the legal moves are the leaves
+        nodes += (depth == 1 ? 1 : run(depth - 1));
+
+        _board.undoMove();
+    }
+
+    if (hashed) {
+        _table->store(key, depth, nodes);
+    }
+
+    return nodes;
+}
+
+namespace {
+
+// The search state of one thread. The Board is a copy of the root, so it
+// also shares the root's hash keys.
+struct PerftWorker {
+    Board board;
+    Generator generator{board};
+    MoveChecker checker{board};
+    Perft perft;
+
+    PerftWorker(const Board& root, PerftTable *table) : board(root),
+        perft(board, generator, checker, table) {}
+};
+
+}  // namespace
+
+U64 parallelPerft(const Board& board, int depth, unsigned int threads,
+        size_t hashMB, std::vector<std::pair<uint16_t, U64>> *rootCounts) {
+    std::unique_ptr<PerftTable> table;
+    if (hashMB > 0) {
+        table.reset(new PerftTable(hashMB));
+    }
+
+    if (depth <= 0) {
+        return 1;
+    }
+
+    PerftWorker root(board, table.get());
+    uint16_t moves[MAX_MOVES_AT_STEP];
+    uint16_t movesLen = 0;
+    root.perft.legalMoves(moves, &movesLen);
+
+    std::vector<std::atomic<U64>> counts(movesLen);
+    for (auto& count : counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+
+    if (depth <= 2) {
+        // Too small to be worth splitting
+        for (int i = 0; i < movesLen; ++i) {
+            root.board.applyMove(moves[i]);
+            counts[i] = root.perft.run(depth - 1);
+            root.board.undoMove();
+        }
+    } else {
+        ThreadPool pool(threads);
+        std::vector<std::unique_ptr<PerftWorker>> workers(pool.size());
+
+        for (int i = 0; i < movesLen; ++i) {
+            uint16_t replies[MAX_MOVES_AT_STEP];
+            uint16_t repliesLen = 0;
+
+            root.board.applyMove(moves[i]);
+            root.perft.legalMoves(replies, &repliesLen);
+            root.board.undoMove();
+
+            for (int j = 0; j < repliesLen; ++j) {
+                uint16_t move = moves[i], reply = replies[j];
+                std::atomic<U64> *count = &counts[i];
+
+                pool.submit([&, move, reply, count](unsigned int index) {
+                    // Only this thread ever touches workers[index]
+                    if (!workers[index]) {
+                        workers[index].reset(
+                            new PerftWorker(board, table.get()));
+                    }
+                    PerftWorker& worker = *workers[index];
+
+                    worker.board.applyMove(move);
+                    worker.board.applyMove(reply);
+                    *count += worker.perft.run(depth - 2);
+                    worker.board.undoMove();
+                    worker.board.undoMove();
+                });
+            }
+        }
+
+        pool.wait();
+    }
+
+    U64 nodes = 0;
+    for (int i = 0; i < movesLen; ++i) {
+        nodes += counts[i];
+        if (rootCounts != NULL) {
+            rootCounts->push_back({moves[i], counts[i]});
+        }
+    }
+
+    return nodes;
+}
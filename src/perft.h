@@ -0,0 +1,94 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "./board.h"
+#include "./moveGen.h"
+#include "./moveChecker.h"
+#include "./utils.h"
+
+/**
+ * (position, depth) -> leaf count table, shared by all the perft workers.
+ *
+ * It takes no locks: every entry stores its data and its key xor-ed with the
+ * data, so an entry torn by two threads writing at once fails the key check
+ * on probe instead of returning a wrong count.
+ */
+class PerftTable {
+ public:
+    /**
+     * @param sizeMB the size of the table, rounded down to a power of 2
+     * entries
+     */
+    explicit PerftTable(size_t sizeMB);
+
+    /**
+     * @return Returns false if the position was not stored at this depth.
+     */
+    bool probe(U64 key, int depth, U64 *count);
+
+    void store(U64 key, int depth, U64 count);
+
+ private:
+    struct Entry {
+        // key ^ data
+        std::atomic<U64> check;
+        // count << 8 | depth
+        std::atomic<U64> data;
+    };
+
+    std::unique_ptr<Entry[]> entries;
+    size_t mask;
+};
+
+/**
+ * Counts the leaves of the legal move tree on a board. Search threads each
+ * need their own Perft, Board, Generator and MoveChecker.
+ */
+class Perft {
+ public:
+    /**
+     * @param table optional, shared transposition table
+     */
+    Perft(Board& board, Generator& generator, MoveChecker& checker,
+        PerftTable *table = NULL);
+
+    /**
+     * At depth 1 the legal moves are counted instead of being recursed
+     * into.
+     *
+     * @param depth the depth of the tree, in plies
+     */
+    U64 run(int depth);
+
+    /**
+     * Generates only the legal moves of the current position.
+     */
+    void legalMoves(uint16_t *moves, uint16_t *movesLen);
+
+ private:
+    Board& _board;
+    Generator& _generator;
+    MoveChecker& _checker;
+    PerftTable *_table;
+};
+
+/**
+ * Perft split over a pool of threads. The tree is cut two plies below the
+ * root, every (root move, reply) subtree is a job, and the workers share a
+ * PerftTable so transpositions are counted once.
+ *
+ * @param board the root position, left unchanged
+ * @param threads the number of threads, 0 for all hardware threads
+ * @param hashMB the size of the shared table, 0 to disable it
+ * @param rootCounts if not NULL, filled with the node count under every
+ * legal root move, in generation order
+ */
+U64 parallelPerft(const Board& board, int depth, unsigned int threads,
+    size_t hashMB, std::vector<std::pair<uint16_t, U64>> *rootCounts);
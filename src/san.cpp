@@ -0,0 +1,211 @@
+/* Copyright 2021 DucaPowr Team */
+#include "./san.h"
+
+#include "./constants.h"
+#include "./perft.h"
+
+#define NO_MOVE 0xffff
+
+// Piece letters by type, in the order of enumPiece (pawn, bishop, knight,
+// rook, queen, king)
+static const char pieceLetters[] = "PBNRQK";
+// Promotion letters by the promotion bits of a move
+static const char promotionLetters[] = "RNBQ";
+
+static int moveSrc(uint16_t move) {
+    return move & 0x3f;
+}
+
+static int moveDst(uint16_t move) {
+    return (move >> 6) & 0x3f;
+}
+
+static int moveFlags(uint16_t move) {
+    return move >> 14;
+}
+
+// @return the type of the piece on a square (enumPiece / 2), -1 if empty
+static int pieceTypeAt(Board& board, int square) {
+    U64 squareBB = 1ULL << square;
+    for (int i = 0; i < 12; i++) {
+        if (board.pieceBB[i] & squareBB) {
+            return i >> 1;
+        }
+    }
+    return -1;
+}
+
+static int pieceTypeFromLetter(char c) {
+    for (int i = 0; i < 6; i++) {
+        if (pieceLetters[i] == c) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint16_t parseSan(Board& board, Generator& generator, MoveChecker& checker,
+        std::string san) {
+    // Drop the check, mate and annotation suffixes
+    while (!san.empty() && (san.back() == '+' || san.back() == '#' ||
+            san.back() == '!' || san.back() == '?')) {
+        san.pop_back();
+    }
+
+    uint16_t moves[MAX_MOVES_AT_STEP];
+    uint16_t movesLen = 0;
+    Perft(board, generator, checker).legalMoves(moves, &movesLen);
+
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        // The king ends on the g file when castling king side, c otherwise
+        int file = san.size() == 3 ? 6 : 2;
+        for (int i = 0; i < movesLen; i++) {
+            if (moveFlags(moves[i]) == 3 && moveDst(moves[i]) % 8 == file) {
+                return moves[i];
+            }
+        }
+        return NO_MOVE;
+    }
+
+    // Piece
+    size_t i = 0;
+    int type = 0;
+    if (i < san.size() && pieceTypeFromLetter(san[i]) > 0) {
+        type = pieceTypeFromLetter(san[i++]);
+    }
+
+    // Promotion, with or without the "="
+    int promotion = -1;
+    for (int p = 0; p < 4 && type == 0 && !san.empty(); p++) {
+        if (promotionLetters[p] == san.back()) {
+            promotion = p;
+            san.pop_back();
+            if (!san.empty() && san.back() == '=') {
+                san.pop_back();
+            }
+            break;
+        }
+    }
+
+    // Destination square
+    if (san.size() < i + 2) {
+        return NO_MOVE;
+    }
+    int dstFile = san[san.size() - 2] - 'a';
+    int dstRank = san[san.size() - 1] - '1';
+    if (dstFile < 0 || dstFile > 7 || dstRank < 0 || dstRank > 7) {
+        return NO_MOVE;
+    }
+
+    // Disambiguation: source file and/or rank, between the piece and the
+    // destination
+    int srcFile = -1, srcRank = -1;
+    for (; i < san.size() - 2; i++) {
+        if (san[i] >= 'a' && san[i] <= 'h') {
+            srcFile = san[i] - 'a';
+        } else if (san[i] >= '1' && san[i] <= '8') {
+            srcRank = san[i] - '1';
+        } else if (san[i] != 'x' && san[i] != '-') {
+            return NO_MOVE;
+        }
+    }
+
+    uint16_t found = NO_MOVE;
+    for (int m = 0; m < movesLen; m++) {
+        uint16_t move = moves[m];
+        int src = moveSrc(move);
+
+        if (moveDst(move) != dstRank * 8 + dstFile ||
+                moveFlags(move) == 3 ||
+                pieceTypeAt(board, src) != type ||
+                (srcFile >= 0 && src % 8 != srcFile) ||
+                (srcRank >= 0 && src / 8 != srcRank)) {
+            continue;
+        }
+
+        bool isPromotion = moveFlags(move) == 1;
+        if (isPromotion != (promotion >= 0) ||
+                (isPromotion && ((move >> 12) & 3) != promotion)) {
+            continue;
+        }
+
+        if (found != NO_MOVE) {
+            // Ambiguous
+            return NO_MOVE;
+        }
+        found = move;
+    }
+
+    return found;
+}
+
+std::string moveToSan(Board& board, Generator& generator,
+        MoveChecker& checker, uint16_t move) {
+    uint16_t moves[MAX_MOVES_AT_STEP];
+    uint16_t movesLen = 0;
+    Perft perft(board, generator, checker);
+    perft.legalMoves(moves, &movesLen);
+
+    int src = moveSrc(move), dst = moveDst(move);
+    int type = pieceTypeAt(board, src);
+    std::string san;
+
+    if (moveFlags(move) == 3) {
+        san = dst % 8 == 6 ? "O-O" : "O-O-O";
+    } else {
+        // A pawn that changes file always captures, en passant included
+        bool capture = pieceTypeAt(board, dst) >= 0 ||
+            (type == 0 && src % 8 != dst % 8);
+
+        if (type == 0) {
+            if (capture) {
+                san += static_cast<char>('a' + src % 8);
+            }
+        } else {
+            san += pieceLetters[type];
+
+            // Other pieces of the same type that can go to the same square
+            bool ambiguous = false, sameFile = false, sameRank = false;
+            for (int i = 0; i < movesLen; i++) {
+                int other = moveSrc(moves[i]);
+                if (other == src || moveDst(moves[i]) != dst ||
+                        pieceTypeAt(board, other) != type) {
+                    continue;
+                }
+                ambiguous = true;
+                sameFile |= other % 8 == src % 8;
+                sameRank |= other / 8 == src / 8;
+            }
+
+            if (ambiguous && (!sameFile || sameRank)) {
+                san += static_cast<char>('a' + src % 8);
+            }
+            if (ambiguous && sameFile) {
+                san += static_cast<char>('1' + src / 8);
+            }
+        }
+
+        if (capture) {
+            san += 'x';
+        }
+        san += static_cast<char>('a' + dst % 8);
+        san += static_cast<char>('1' + dst / 8);
+
+        if (moveFlags(move) == 1) {
+            san += '=';
+            san += promotionLetters[(move >> 12) & 3];
+        }
+    }
+
+    // Check and mate suffixes
+    board.applyMove(move);
+    if (checker.isCheck(generator.getAttackBB(otherSide(board.sideToMove)))) {
+        uint16_t replies[MAX_MOVES_AT_STEP];
+        uint16_t repliesLen = 0;
+        perft.legalMoves(replies, &repliesLen);
+        san += repliesLen == 0 ? '#' : '+';
+    }
+    board.undoMove();
+
+    return san;
+}
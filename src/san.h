@@ -0,0 +1,32 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "./board.h"
+#include "./moveGen.h"
+#include "./moveChecker.h"
+
+/**
+ * Standard algebraic notation (eg: Nf3, exd5, O-O, e8=Q+), as used by PGN and
+ * EPD files. Note: Board::convertSanToMove() reads the xboard "san=0"
+ * coordinate notation instead.
+ */
+
+/**
+ * Finds the legal move of the current position written in SAN. The check,
+ * mate and annotation suffixes are ignored, and so is a missing "=" before
+ * the promotion piece.
+ *
+ * @return the move, 0xffff if no legal move matches
+ */
+uint16_t parseSan(Board& board, Generator& generator, MoveChecker& checker,
+    std::string san);
+
+/**
+ * Writes a legal move of the current position in SAN, with the "+" and "#"
+ * suffixes.
+ */
+std::string moveToSan(Board& board, Generator& generator,
+    MoveChecker& checker, uint16_t move);
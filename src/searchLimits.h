@@ -0,0 +1,32 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include "./utils.h"
+
+/**
+ * What the engine may spend on a move, from the xboard time control
+ * commands. A default SearchLimits searches to DEFAULT_SEARCH_DEPTH.
+ */
+struct SearchLimits {
+    // Maximum depth (sd), 0 for none
+    int depth = 0;
+
+    // Seconds for every move (st), 0 if not set
+    double moveTime = 0;
+
+    // Clocks of the engine and of its opponent in seconds (time, otim),
+    // negative while unknown
+    double time = -1;
+    double otherTime = -1;
+
+    // Moves until the next time control (level MPS), 0 for the whole game
+    int movesToGo = 0;
+    // Seconds added after every move (level INC)
+    double increment = 0;
+
+    // Nodes to search, checked every CLOCK_CHECK_NODES nodes, 0 for no limit
+    U64 nodes = 0;
+
+    // Search until stopped (analyze)
+    bool infinite = false;
+};
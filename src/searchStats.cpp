@@ -0,0 +1,55 @@
+/* Copyright 2021 DucaPowr Team */
+#include "./searchStats.h"
+
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+void SearchStats::clear(void) {
+    memset(this, 0, sizeof(*this));
+}
+
+// Avoids dividing by zero for the ratios
+static double ratio(U64 a, U64 b) {
+    return b == 0 ? 0 : static_cast<double>(a) / b;
+}
+
+std::string SearchStats::toString(void) const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+
+    out << "nodes " << nodes << " time " << seconds << " s nps " <<
+        static_cast<U64>(seconds > 0 ? nodes / seconds : 0) << '\n';
+    out << "eval calls " << evalCalls << '\n';
+    out << "cutoffs " << cutoffs << " first move " <<
+        100 * ratio(firstMoveCutoffs, cutoffs) << "%\n";
+    out << "legal moves " << legalMoves << " / " << pseudoLegalMoves <<
+        " pseudo-legal " << 100 * ratio(legalMoves, pseudoLegalMoves) <<
+        "%\n";
+    out << "hash probes " << ttProbes << " hits " <<
+        100 * ratio(ttHits, ttProbes) << "% cutoffs " << ttCutoffs << '\n';
+    out << "endgame hits " << endgameHits << '\n';
+    if (helperNodes) {
+        out << "helper nodes " << helperNodes << '\n';
+    }
+
+    // The effective branching factor of ply i is how many times more nodes
+    // it took than ply i - 1
+    out << "ply nodes ebf";
+    for (int ply = 0; ply < STATS_MAX_PLY && plyNodes[ply]; ply++) {
+        out << "\n" << ply << ' ' << plyNodes[ply];
+        if (ply > 0) {
+            out << ' ' << ratio(plyNodes[ply], plyNodes[ply - 1]);
+        }
+    }
+
+    if (depth > 0) {
+        out << "\ndepth nodes time";
+        for (int d = 1; d <= depth && d < STATS_MAX_PLY; d++) {
+            out << '\n' << d << ' ' << iterationNodes[d] << ' ' <<
+                iterationSeconds[d];
+        }
+    }
+
+    return out.str();
+}
@@ -0,0 +1,63 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include <string>
+
+#include "./utils.h"
+
+// Deepest ply the per-ply counters track
+#define STATS_MAX_PLY 64
+
+/**
+ * Counters collected by the search. They are plain integers bumped in the
+ * search loop, so collecting them is almost free.
+ */
+struct SearchStats {
+    // Nodes visited, leaves included
+    U64 nodes;
+    U64 evalCalls;
+
+    // Fail-high (or fail-low, in min nodes) cutoffs, and how many of them
+    // came from the first legal move searched
+    U64 cutoffs;
+    U64 firstMoveCutoffs;
+
+    // Moves tried, and how many of them passed the legality checks
+    U64 pseudoLegalMoves;
+    U64 legalMoves;
+
+    // Transposition table probes, how many of them found the position and
+    // how many of those ended the node without searching it
+    U64 ttProbes;
+    U64 ttHits;
+    U64 ttCutoffs;
+
+    // Nodes scored by the endgame recognizers, without a search
+    U64 endgameHits;
+
+    // Nodes visited by the helper threads of a Lazy SMP search, not
+    // counted in nodes
+    U64 helperNodes;
+
+    // Nodes visited at every ply from the root
+    U64 plyNodes[STATS_MAX_PLY];
+
+    double seconds;
+
+    // Last completed iteration of an iterative deepening search, with the
+    // nodes, the seconds and the best move of every iteration (indexed by
+    // depth)
+    int depth;
+    U64 iterationNodes[STATS_MAX_PLY];
+    double iterationSeconds[STATS_MAX_PLY];
+    uint16_t iterationMoves[STATS_MAX_PLY];
+
+    void clear(void);
+
+    /**
+     * @return Returns a multi-line report: the counters, their ratios, the
+     * effective branching factor at every ply and the cost of every
+     * iteration.
+     */
+    std::string toString(void) const;
+};
@@ -0,0 +1,249 @@
+/* Copyright 2021 DucaPowr Team */
+#include "./server.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+
+#include "./engine.h"
+#include "./logger.h"
+#include "./uciHandler.h"
+#include "./xboardHandler.h"
+
+// Bytes read from a socket at a time
+#define SERVER_READ_SIZE 4096
+
+/**
+ * Unbuffered output to a socket. The handler and a UCI search thread may
+ * write at the same time, so every write is sent whole, under a lock.
+ */
+class SocketBuf : public std::streambuf {
+ public:
+    explicit SocketBuf(int fd) : fd(fd) {}
+
+ protected:
+    int overflow(int c) override {
+        if (c == traits_type::eof()) {
+            return traits_type::not_eof(c);
+        }
+        char ch = static_cast<char>(c);
+        return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::streamsize sent = 0;
+        while (sent < n) {
+            // A client that left must not kill the server with SIGPIPE
+            ssize_t len = send(fd, s + sent, n - sent, MSG_NOSIGNAL);
+            if (len < 0 && errno == EINTR) {
+                continue;
+            }
+            if (len <= 0) {
+                return sent;
+            }
+            sent += len;
+        }
+        return sent;
+    }
+
+ private:
+    int fd;
+    std::mutex mutex;
+};
+
+struct Server::Session {
+    int fd;
+    SocketBuf buf;
+    std::ostream out;
+    Engine engine;
+    // Created by the first line
+    std::unique_ptr<xBoardHandler> xboard;
+    std::unique_ptr<UciHandler> uci;
+
+    // A line not complete yet, only read by the polling thread
+    std::string input;
+
+    // Commands not handled yet, and whether the session is on the pool
+    std::mutex mutex;
+    std::deque<std::string> lines;
+    bool scheduled = false;
+
+    Session(int fd, std::shared_ptr<TranspositionTable> table)
+        : fd(fd), buf(fd), out(&buf), engine(table) {
+    }
+
+    ~Session() {
+        // Nothing may write to the socket once it is closed
+        engine.stopSearch();
+        ::close(fd);
+    }
+};
+
+Server::Server(const std::string& socketPath, unsigned int workers,
+        size_t hashMB)
+    : socketPath(socketPath),
+      table(std::make_shared<TranspositionTable>(hashMB)),
+      pool(workers) {
+}
+
+Server::~Server() {
+    if (listenFd >= 0) {
+        ::close(listenFd);
+        unlink(socketPath.c_str());
+    }
+}
+
+bool Server::run(void) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    strncpy(address.sun_path, socketPath.c_str(),
+        sizeof(address.sun_path) - 1);
+
+    // A socket file left by a server that died is replaced
+    unlink(socketPath.c_str());
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0 ||
+            bind(listenFd, reinterpret_cast<struct sockaddr *>(&address),
+            sizeof(address)) < 0 ||
+            listen(listenFd, SOMAXCONN) < 0) {
+        return false;
+    }
+    LOG_INFO("Serving games on " + socketPath);
+
+    std::vector<struct pollfd> fds;
+    while (true) {
+        fds.clear();
+        fds.push_back({listenFd, POLLIN, 0});
+        for (auto& session : sessions) {
+            fds.push_back({session->fd, POLLIN, 0});
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return true;
+        }
+
+        // Sessions accepted now are polled from the next round
+        size_t polled = sessions.size();
+        for (size_t i = 0; i < polled; i++) {
+            if (fds[i + 1].revents && !readClient(sessions[i])) {
+                // The last command still holds the session
+                sessions[i].reset();
+            }
+        }
+        sessions.erase(std::remove(sessions.begin(), sessions.end(),
+            nullptr), sessions.end());
+
+        if (fds[0].revents & POLLIN) {
+            acceptClient();
+        }
+    }
+}
+
+void Server::acceptClient(void) {
+    int fd = accept(listenFd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    sessions.push_back(std::make_shared<Session>(fd, table));
+    LOG_INFO("New game, " + std::to_string(sessions.size()) + " running");
+}
+
+bool Server::readClient(const std::shared_ptr<Session>& session) {
+    char buffer[SERVER_READ_SIZE];
+    ssize_t len = recv(session->fd, buffer, sizeof(buffer), 0);
+    if (len < 0 && errno == EINTR) {
+        return true;
+    }
+    if (len <= 0) {
+        // A game left without quit still stops its search
+        enqueue(session, "quit");
+        return false;
+    }
+
+    session->input.append(buffer, len);
+    size_t start = 0, end;
+    while ((end = session->input.find('\n', start)) != std::string::npos) {
+        std::string line = session->input.substr(start, end - start);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        enqueue(session, line);
+        start = end + 1;
+    }
+    session->input.erase(0, start);
+    return true;
+}
+
+void Server::enqueue(const std::shared_ptr<Session>& session,
+        const std::string& line) {
+    std::lock_guard<std::mutex> lock(session->mutex);
+    session->lines.push_back(line);
+    if (session->scheduled) {
+        return;
+    }
+
+    session->scheduled = true;
+    pool.submit([session](unsigned int) {
+        drain(*session);
+    });
+}
+
+void Server::drain(Session& session) {
+    while (true) {
+        std::string line;
+        {
+            std::lock_guard<std::mutex> lock(session.mutex);
+            if (session.lines.empty()) {
+                session.scheduled = false;
+                return;
+            }
+            line = session.lines.front();
+            session.lines.pop_front();
+        }
+        handle(session, line);
+    }
+}
+
+void Server::handle(Session& session, const std::string& line) {
+    if (!session.engine.isRunning()) {
+        return;
+    }
+
+    if (session.xboard) {
+        session.xboard->handle(line);
+    } else if (session.uci) {
+        session.uci->handle(line);
+    } else if (line == "uci") {
+        session.uci.reset(new UciHandler(session.engine, session.out));
+        session.uci->init();
+    } else if (line == "xboard") {
+        // protover is answered by the handler
+        session.xboard.reset(new xBoardHandler(session.engine, session.out));
+    } else if (line == "quit") {
+        session.engine.close();
+    } else {
+        session.out << "Error (xboard or uci expected): " << line <<
+            std::endl;
+    }
+
+    // The polling thread sees the socket closing and drops the session
+    if (!session.engine.isRunning()) {
+        shutdown(session.fd, SHUT_RDWR);
+    }
+}
@@ -0,0 +1,70 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "./threadPool.h"
+#include "./transpositionTable.h"
+
+/**
+ * Plays many games in one process. Clients connect to a Unix domain
+ * socket, and every connection is one game that talks xboard or UCI as on
+ * the standard input: its first line, "xboard" or "uci", picks the
+ * protocol.
+ *
+ * A game only owns its board and search state. The move generator tables,
+ * the hash keys, the network, the book and the endgame tables are built
+ * once per process, and all the games search with one transposition
+ * table, which they never clear or resize.
+ *
+ * One thread polls the sockets. The commands of a game are handled in
+ * order on a shared pool of workers, so an xboard search holds a worker
+ * and not a thread of its own. UCI searches still run on the engine's
+ * background thread, so that stop is answered while they run.
+ */
+class Server {
+ public:
+    /**
+     * @param workers the number of workers, 0 for all hardware threads
+     * @param hashMB the size of the shared transposition table, in MB
+     */
+    Server(const std::string& socketPath, unsigned int workers,
+        size_t hashMB);
+    ~Server();
+
+    /**
+     * Serves the games until the socket fails.
+     * @return Returns false if the socket cannot be opened.
+     */
+    bool run(void);
+
+ private:
+    struct Session;
+
+    std::string socketPath;
+    int listenFd = -1;
+
+    std::shared_ptr<TranspositionTable> table;
+    ThreadPool pool;
+
+    // Only the polling thread touches the list
+    std::vector<std::shared_ptr<Session>> sessions;
+
+    void acceptClient(void);
+
+    /**
+     * Reads the commands a client sent and queues the complete lines.
+     * @return Returns false once the client is gone.
+     */
+    bool readClient(const std::shared_ptr<Session>& session);
+
+    // Queues a command, and the session on the pool if it is idle
+    void enqueue(const std::shared_ptr<Session>& session,
+        const std::string& line);
+    // Runs on a worker until the queue of the session is empty
+    static void drain(Session& session);
+    static void handle(Session& session, const std::string& line);
+};
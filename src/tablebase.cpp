@@ -0,0 +1,350 @@
+/* Copyright 2021 DucaPowr Team */
+#include "./tablebase.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include "./constants.h"
+
+std::vector<Tablebases::Table> Tablebases::tables;
+int Tablebases::pieces = 0;
+
+// Piece kinds in the order of a material string
+static const char TB_PIECE_LETTERS[] = "KQRBNP";
+static const enum enumPiece TB_PIECE_KINDS[] = {nWhiteKing, nWhiteQueen,
+    nWhiteRook, nWhiteBishop, nWhiteKnight, nWhitePawn};
+
+bool TablebaseLayout::parse(const std::string& material) {
+    size_t separator = material.find('v');
+    if (separator == std::string::npos) {
+        return false;
+    }
+
+    std::string sides[2] = {material.substr(0, separator),
+        material.substr(separator + 1)};
+    count = 0;
+    name.clear();
+
+    for (int side = 0; side < 2; side++) {
+        // Pieces of the same kind have to be next to each other
+        std::string letters = sides[side];
+        std::sort(letters.begin(), letters.end(), [](char a, char b) {
+            return strchr(TB_PIECE_LETTERS, a) < strchr(TB_PIECE_LETTERS, b);
+        });
+        if (letters.empty() || letters[0] != 'K' ||
+                std::count(letters.begin(), letters.end(), 'K') != 1) {
+            return false;
+        }
+
+        for (char letter : letters) {
+            const char *kind = strchr(TB_PIECE_LETTERS, letter);
+            if (letter == '\0' || kind == NULL || count == TB_MAX_PIECES) {
+                return false;
+            }
+            pieces[count++] = static_cast<enum enumPiece>(
+                TB_PIECE_KINDS[kind - TB_PIECE_LETTERS] + side);
+        }
+        name += (side == 0 ? "" : "v") + letters;
+    }
+
+    size = 2 * 3 * 3;
+    key = 0;
+    for (int i = 0; i < count; i++) {
+        size *= 64;
+        key += 1ULL << (4 * pieces[i]);
+    }
+    return true;
+}
+
+uint64_t TablebaseLayout::index(const CompactPosition& pos) const {
+    uint64_t result = (pos.sideToMove * 3 + pos.checkCount[whiteSide]) * 3 +
+        pos.checkCount[blackSide];
+
+    for (int i = 0; i < count;) {
+        enum enumPiece kind = pieces[i];
+        U64 bb = pos.pieceBB[kind];
+        for (; i < count && pieces[i] == kind; i++) {
+            result = result * 64 + getSquareIndex(bb);
+            bb &= bb - 1;
+        }
+    }
+    return result;
+}
+
+bool TablebaseLayout::decode(uint64_t index, CompactPosition *pos) const {
+    int squares[TB_MAX_PIECES];
+    for (int i = count - 1; i >= 0; i--) {
+        squares[i] = index & 63;
+        index >>= 6;
+    }
+
+    memset(pos, 0, sizeof(*pos));
+    pos->checkCount[blackSide] = index % 3;
+    index /= 3;
+    pos->checkCount[whiteSide] = index % 3;
+    pos->sideToMove = index / 3;
+
+    U64 occupied = 0;
+    for (int i = 0; i < count; i++) {
+        U64 bit = 1ULL << squares[i];
+        if ((occupied & bit) ||
+                ((pieces[i] >> 1) == (nWhitePawn >> 1) &&
+                (bit & (RANK1 | RANK8)))) {
+            return false;
+        }
+        // Only the increasing order of twin pieces is indexed
+        if (i > 0 && pieces[i] == pieces[i - 1] &&
+                squares[i] < squares[i - 1]) {
+            return false;
+        }
+        occupied |= bit;
+        pos->pieceBB[pieces[i]] |= bit;
+    }
+    return true;
+}
+
+int Tablebases::open(const std::string& dirName) {
+    DIR *dir = opendir(dirName.c_str());
+    if (dir == NULL) {
+        return 0;
+    }
+
+    int opened = 0;
+    std::string extension = TB_FILE_EXTENSION;
+    while (struct dirent *entry = readdir(dir)) {
+        std::string fileName = entry->d_name;
+        if (fileName.size() > extension.size() &&
+                fileName.compare(fileName.size() - extension.size(),
+                extension.size(), extension) == 0) {
+            opened += add(dirName + "/" + fileName);
+        }
+    }
+    closedir(dir);
+    return opened;
+}
+
+bool Tablebases::add(const std::string& fileName) {
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 ||
+            static_cast<size_t>(st.st_size) < sizeof(TablebaseHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    // The mapping stays valid once the file is closed
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    Table table;
+    table.map = static_cast<const uint8_t *>(map);
+    table.mapSize = st.st_size;
+
+    TablebaseHeader header;
+    memcpy(&header, table.map, sizeof(header));
+    header.name[sizeof(header.name) - 1] = '\0';
+
+    size_t dataStart = sizeof(header) +
+        (header.blocks + 1) * sizeof(uint64_t);
+    table.offsets = reinterpret_cast<const uint64_t *>(table.map +
+        sizeof(header));
+    table.data = table.map + dataStart;
+
+    bool valid = header.magic == TB_MAGIC &&
+        header.blockSize == TB_BLOCK_SIZE &&
+        table.layout.parse(header.name) &&
+        table.layout.size == header.size &&
+        header.blocks == (header.size + TB_BLOCK_SIZE - 1) / TB_BLOCK_SIZE &&
+        dataStart <= table.mapSize &&
+        table.offsets[header.blocks] == table.mapSize - dataStart;
+
+    // A second table of the same material would never be read
+    for (const Table& other : tables) {
+        valid &= other.layout.key != table.layout.key;
+    }
+
+    if (!valid) {
+        munmap(const_cast<uint8_t *>(table.map), table.mapSize);
+        return false;
+    }
+
+    tables.push_back(table);
+    pieces = std::max(pieces, table.layout.count);
+    return true;
+}
+
+bool Tablebases::write(const std::string& fileName,
+        const TablebaseLayout& layout, const int8_t *values) {
+    TablebaseHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = TB_MAGIC;
+    header.blockSize = TB_BLOCK_SIZE;
+    header.size = layout.size;
+    header.blocks = (layout.size + TB_BLOCK_SIZE - 1) / TB_BLOCK_SIZE;
+    snprintf(header.name, sizeof(header.name), "%s", layout.name.c_str());
+
+    auto at = [&](uint64_t i) {
+        return static_cast<uint8_t>(values[i]);
+    };
+
+    std::vector<uint64_t> offsets;
+    std::vector<uint8_t> data;
+    for (uint64_t block = 0; block < header.blocks; block++) {
+        offsets.push_back(data.size());
+        uint64_t last = std::min(layout.size, (block + 1) * TB_BLOCK_SIZE);
+
+        for (uint64_t index = block * TB_BLOCK_SIZE; index < last;) {
+            uint64_t run = 1;
+            while (index + run < last && run < 129 &&
+                    at(index + run) == at(index)) {
+                run++;
+            }
+            if (run >= 2) {
+                data.push_back(126 + run);
+                data.push_back(at(index));
+                index += run;
+                continue;
+            }
+
+            // Literals up to the start of the next run
+            uint64_t end = index + 1;
+            while (end < last && end - index < 128 &&
+                    !(end + 1 < last && at(end + 1) == at(end))) {
+                end++;
+            }
+            data.push_back(end - index - 1);
+            for (; index < end; index++) {
+                data.push_back(at(index));
+            }
+        }
+    }
+    offsets.push_back(data.size());
+
+    // Written next to the table and renamed, so a crash leaves the old one
+    std::string tmpName = fileName + ".tmp";
+    std::ofstream out(tmpName, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(offsets.data()),
+        offsets.size() * sizeof(uint64_t));
+    out.write(reinterpret_cast<const char *>(data.data()), data.size());
+    out.close();
+    return out && rename(tmpName.c_str(), fileName.c_str()) == 0;
+}
+
+void Tablebases::close(void) {
+    for (const Table& table : tables) {
+        munmap(const_cast<uint8_t *>(table.map), table.mapSize);
+    }
+    tables.clear();
+    pieces = 0;
+}
+
+int Tablebases::maxPieces(void) {
+    return pieces;
+}
+
+U64 Tablebases::key(const U64 *pieceBB) {
+    U64 result = 0;
+    for (int piece = 0; piece < 12; piece++) {
+        result += static_cast<U64>(__builtin_popcountll(pieceBB[piece])) <<
+            (4 * piece);
+    }
+    return result;
+}
+
+int Tablebases::read(const Table& table, uint64_t index) {
+    const uint8_t *p = table.data + table.offsets[index / TB_BLOCK_SIZE];
+    uint64_t offset = index % TB_BLOCK_SIZE;
+    while (true) {
+        uint8_t control = *p++;
+        if (control < 128) {
+            // Literal values
+            if (offset <= control) {
+                return static_cast<int8_t>(p[offset]);
+            }
+            offset -= control + 1;
+            p += control + 1;
+        } else {
+            if (offset < control - 126U) {
+                return static_cast<int8_t>(*p);
+            }
+            offset -= control - 126;
+            p++;
+        }
+    }
+}
+
+bool Tablebases::value(const CompactPosition& pos, int *value) {
+    if (pos.checkCount[whiteSide] >= 3 || pos.checkCount[blackSide] >= 3) {
+        return false;
+    }
+
+    // White pieces count in the even nibbles, black ones in the odd ones
+    U64 key = Tablebases::key(pos.pieceBB);
+    U64 swapped = ((key & 0x0f0f0f0f0f0fULL) << 4) |
+        ((key >> 4) & 0x0f0f0f0f0f0fULL);
+
+    for (const Table& table : tables) {
+        if (table.layout.key == key) {
+            *value = read(table, table.layout.index(pos));
+            return true;
+        }
+
+        if (table.layout.key == swapped) {
+            // Colours swapped and the board flipped
+            CompactPosition flipped;
+            for (int piece = 0; piece < 12; piece++) {
+                flipped.pieceBB[piece ^ 1] =
+                    __builtin_bswap64(pos.pieceBB[piece]);
+            }
+            flipped.checkCount[whiteSide] = pos.checkCount[blackSide];
+            flipped.checkCount[blackSide] = pos.checkCount[whiteSide];
+            flipped.sideToMove = otherSide(static_cast<Side>(pos.sideToMove));
+
+            *value = read(table, table.layout.index(flipped));
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Tablebases::probe(Board& board, int *score) {
+    if (__builtin_popcountll(board.getAllBB()) > pieces) {
+        return false;
+    }
+
+    // Castling rights and the en passant pawn, bits 0-15
+    if (board.getFlags() & (FLAGS_INIT_VALUE | 0xffff)) {
+        return false;
+    }
+
+    CompactPosition pos;
+    board.getPosition(&pos);
+    int stored;
+    if (!value(pos, &stored)) {
+        return false;
+    }
+
+    if (stored == TB_DRAW) {
+        *score = 0;
+    } else if (stored > 0) {
+        *score = TB_WIN_SCORE - stored;
+    } else {
+        *score = -(TB_WIN_SCORE - (-stored - 1));
+    }
+    return true;
+}
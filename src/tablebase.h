@@ -0,0 +1,139 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "./board.h"
+#include "./utils.h"
+
+// Kings included
+#define TB_MAX_PIECES       4
+
+#define TB_MAGIC            0x31425444U  // "DTB1"
+#define TB_BLOCK_SIZE       1024
+#define TB_FILE_EXTENSION   ".dtb"
+
+/**
+ * Stored value of a position, from the point of view of the side to move:
+ * 0 is a draw, v > 0 a win in v plies, v < 0 a loss in -v - 1 plies (-1 is
+ * mated or checked for the third time).
+ */
+#define TB_DRAW             0
+#define TB_UNDECIDED        (-128)
+
+/**
+ * The positions of one material, eg: KQvK, the white pieces first. The
+ * index is built from the side to move, the checks received by white and
+ * by black (0-2 each) and then 6 bits per piece, in the order of the
+ * material string with the kings first. Pieces of the same kind take their
+ * squares in increasing order.
+ */
+struct TablebaseLayout {
+    std::string name;
+    enum enumPiece pieces[TB_MAX_PIECES];
+    int count;
+    uint64_t size;
+    // Number of pieces of every kind, 4 bits each, see Tablebases::key()
+    U64 key;
+
+    /**
+     * @return Returns false if the name is not a material of at most
+     * TB_MAX_PIECES pieces with one king a side.
+     */
+    bool parse(const std::string& material);
+
+    uint64_t index(const CompactPosition& pos) const;
+
+    /**
+     * @return Returns false if two pieces stand on the same square; the
+     * position may still be illegal, with the side not to move in check.
+     */
+    bool decode(uint64_t index, CompactPosition *pos) const;
+};
+
+/**
+ * Header of a table file. It is followed by blocks + 1 offsets (uint64,
+ * from the start of the data) and by the data: every block of
+ * TB_BLOCK_SIZE values is packed like PackBits, a control byte c < 128 is
+ * followed by c + 1 values, and c >= 128 by one value repeated c - 126
+ * times. The file is mapped and a probe decodes a single block.
+ */
+struct TablebaseHeader {
+    uint32_t magic;
+    uint32_t blockSize;
+    uint64_t size;
+    uint64_t blocks;
+    char name[16];
+};
+
+/**
+ * Endgame tables of 3-check, built by tools/tbgen. Every table of a
+ * directory is mapped at startup and shared read only by all the search
+ * threads, so probing takes no locks and allocates nothing.
+ *
+ * Positions with castling or en passant rights are not in the tables.
+ */
+class Tablebases {
+ public:
+    /**
+     * Maps every table of a directory.
+     * @return Returns the number of tables mapped.
+     */
+    static int open(const std::string& dirName);
+
+    /**
+     * Maps one table file.
+     * @return Returns false if the file is missing or is not a table.
+     */
+    static bool add(const std::string& fileName);
+    static void close(void);
+
+    /**
+     * Writes a table file, see TablebaseHeader. Positions that can never
+     * be probed should get the value before them, so they lengthen the
+     * runs.
+     * @param values the stored value of every index of the layout
+     * @return Returns false if the file cannot be written.
+     */
+    static bool write(const std::string& fileName,
+        const TablebaseLayout& layout, const int8_t *values);
+
+    // Largest number of pieces of a mapped table, 0 without tables
+    static int maxPieces(void);
+
+    // Material key of a position, see TablebaseLayout
+    static U64 key(const U64 *pieceBB);
+
+    /**
+     * Looks the position up in the table of its material, or of the colour
+     * swapped material.
+     * @param value gets the stored value, see TB_DRAW
+     * @return Returns false if there is no such table or a side already
+     * received 3 checks.
+     */
+    static bool value(const CompactPosition& pos, int *value);
+
+    /**
+     * @param score gets the search score of the position, from the point
+     * of view of the side to move
+     * @return Returns false if the position is not in the tables.
+     */
+    static bool probe(Board& board, int *score);
+
+ private:
+    struct Table {
+        TablebaseLayout layout;
+        const uint8_t *map;
+        size_t mapSize;
+        const uint64_t *offsets;
+        const uint8_t *data;
+    };
+
+    static std::vector<Table> tables;
+    static int pieces;
+
+    static int read(const Table& table, uint64_t index);
+};
@@ -0,0 +1,75 @@
+/* Copyright 2021 DucaPowr Team */
+#include "./threadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned int i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void(unsigned int)> job) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        jobs.push(std::move(job));
+        pending++;
+    }
+    jobAvailable.notify_one();
+}
+
+void ThreadPool::wait(void) {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobsDone.wait(lock, [this] { return pending == 0; });
+}
+
+unsigned int ThreadPool::size(void) {
+    return workers.size();
+}
+
+void ThreadPool::workerLoop(unsigned int index) {
+    while (true) {
+        std::function<void(unsigned int)> job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this] {
+                return stopping || !jobs.empty();
+            });
+
+            if (jobs.empty()) {
+                // Stopping, and nothing left to run
+                return;
+            }
+
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+
+        job(index);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            pending--;
+            if (pending == 0) {
+                jobsDone.notify_all();
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads running queued jobs. Every job receives the
+ * index of the worker that runs it, so it can use per-worker state (eg: its
+ * own Board and Generator).
+ */
+class ThreadPool {
+ public:
+    /**
+     * @param threads the number of workers, 0 for all hardware threads
+     */
+    explicit ThreadPool(unsigned int threads);
+    ~ThreadPool();
+
+    // Queues a job
+    void submit(std::function<void(unsigned int)> job);
+
+    // Blocks until every queued job is done
+    void wait(void);
+
+    unsigned int size(void);
+
+ private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void(unsigned int)>> jobs;
+
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsDone;
+    // Number of jobs queued or running
+    unsigned int pending = 0;
+    bool stopping = false;
+
+    void workerLoop(unsigned int index);
+};
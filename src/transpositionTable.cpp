@@ -0,0 +1,90 @@
+/* Copyright 2021 DucaPowr Team */
+#include "./transpositionTable.h"
+
+#include <algorithm>
+
+#include "./threadPool.h"
+
+TranspositionTable::TranspositionTable(size_t sizeMB) : mask(0) {
+    resize(sizeMB, 1);
+}
+
+size_t TranspositionTable::entryCount(size_t sizeMB) {
+    size_t count = 1;
+    while (count * 2 * sizeof(Entry) <= (sizeMB << 20)) {
+        count *= 2;
+    }
+    return count;
+}
+
+void TranspositionTable::resize(size_t sizeMB, unsigned int threads) {
+    size_t count = entryCount(sizeMB);
+
+    if (!entries || count != mask + 1) {
+        // Free the old table first, both may not fit at once
+        entries.reset();
+        // Not initialised here: clear() touches the pages in parallel
+        entries.reset(new Entry[count]);
+        mask = count - 1;
+    }
+
+    clear(threads);
+}
+
+void TranspositionTable::clear(unsigned int threads) {
+    size_t count = mask + 1;
+    threads = std::max(threads, 1u);
+
+    auto clearSlice = [this, count, threads](unsigned int slice) {
+        size_t begin = count / threads * slice;
+        size_t end = slice + 1 == threads ? count : count / threads * (slice + 1);
+        for (size_t i = begin; i < end; i++) {
+            entries[i].check.store(0, std::memory_order_relaxed);
+            entries[i].data.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    if (threads == 1) {
+        clearSlice(0);
+        return;
+    }
+
+    ThreadPool pool(threads);
+    for (unsigned int slice = 0; slice < threads; slice++) {
+        pool.submit([&clearSlice, slice](unsigned int) {
+            clearSlice(slice);
+        });
+    }
+    pool.wait();
+}
+
+bool TranspositionTable::probe(U64 key, TTEntry *entry) {
+    Entry& e = entries[key & mask];
+    U64 data = e.data.load(std::memory_order_relaxed);
+    U64 check = e.check.load(std::memory_order_relaxed);
+
+    if ((check ^ data) != key || data == 0) {
+        return false;
+    }
+
+    entry->score = static_cast<int32_t>(data >> 32);
+    entry->move = (data >> 16) & 0xFFFF;
+    entry->depth = (data >> 8) & 0xFF;
+    entry->bound = static_cast<Bound>(data & 0xFF);
+    return true;
+}
+
+void TranspositionTable::store(U64 key, int score, uint16_t move, int depth,
+        Bound bound) {
+    Entry& e = entries[key & mask];
+    U64 data = (static_cast<U64>(static_cast<uint32_t>(score)) << 32) |
+        (static_cast<U64>(move) << 16) | (static_cast<U64>(depth) << 8) |
+        bound;
+
+    e.check.store(key ^ data, std::memory_order_relaxed);
+    e.data.store(data, std::memory_order_relaxed);
+}
+
+size_t TranspositionTable::sizeMB(void) {
+    return ((mask + 1) * sizeof(Entry)) >> 20;
+}
@@ -0,0 +1,75 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+
+#include "./utils.h"
+
+// What a stored score says about the real one
+enum Bound {
+    BOUND_EXACT = 0,
+    // The real score is at least the stored one (the node failed high)
+    BOUND_LOWER = 1,
+    // The real score is at most the stored one (no move reached alpha)
+    BOUND_UPPER = 2,
+};
+
+struct TTEntry {
+    // From the point of view of the side to move
+    int score;
+    uint16_t move;
+    int depth;
+    Bound bound;
+};
+
+/**
+ * Search results by position, shared by all the search threads. Like the
+ * PerftTable it takes no locks: every entry keeps its key xor-ed with its
+ * data, so an entry torn by two threads fails the key check on probe.
+ * Every store replaces the entry in its slot.
+ */
+class TranspositionTable {
+ public:
+    /**
+     * @param sizeMB the size of the table, rounded down to a power of 2
+     * entries
+     */
+    explicit TranspositionTable(size_t sizeMB);
+
+    /**
+     * Reallocates the table if its size changes, then clears it.
+     * @param threads the number of threads clearing it
+     */
+    void resize(size_t sizeMB, unsigned int threads);
+
+    /**
+     * Clears the table, every thread taking a slice of it, so that clearing
+     * a large table does not hold up the first search.
+     */
+    void clear(unsigned int threads);
+
+    /**
+     * @return Returns false if the position is not stored.
+     */
+    bool probe(U64 key, TTEntry *entry);
+
+    void store(U64 key, int score, uint16_t move, int depth, Bound bound);
+
+    size_t sizeMB(void);
+
+ private:
+    struct Entry {
+        // key ^ data
+        std::atomic<U64> check;
+        // score << 32 | move << 16 | depth << 8 | bound
+        std::atomic<U64> data;
+    };
+
+    std::unique_ptr<Entry[]> entries;
+    size_t mask;
+
+    static size_t entryCount(size_t sizeMB);
+};
@@ -0,0 +1,247 @@
+/* Copyright 2021 DucaPowr Team */
+#include "./uciHandler.h"
+
+#include <algorithm>
+#include <iterator>
+
+UciHandler::UciHandler(Engine& engine, std::ostream& out)
+    : _engine(engine), _out(out) {
+}
+
+void UciHandler::init(void) {
+    std::cout.setf(std::ios::unitbuf);
+
+    send("id name DucaPowr");
+    send("id author DucaPowr Team");
+    send("option name Hash type spin default " +
+        std::to_string(DEFAULT_HASH_MB) + " min 1 max 65536");
+    send("option name Threads type spin default " +
+        std::to_string(DEFAULT_THREADS) + " min 1 max 256");
+    send("uciok");
+
+    _engine.setUciOutput(true);
+    _engine.setThinkingOutput([this](const std::string& line) {
+        send(line);
+    });
+
+    _engine.newGame();
+    base = "startpos";
+}
+
+void UciHandler::run(void) {
+    std::string buffer;
+    std::getline(std::cin, buffer);
+    handle(buffer);
+}
+
+void UciHandler::handle(const std::string& buffer) {
+    LOG_INFO("uci -> " + buffer);
+
+    std::istringstream iss(buffer);
+    std::string command;
+    iss >> command;
+
+    // A search still running when the position changes is thrown away
+    if (command == "position" || command == "go" ||
+            command == "ucinewgame" || command == "setoption") {
+        discardBestMove = true;
+        _engine.stopSearch();
+        discardBestMove = false;
+        pondering = false;
+    }
+
+    if (command == "isready") {
+        send("readyok");
+
+    } else if (command == "ucinewgame") {
+        _engine.newGame();
+        base = "startpos";
+        moves.clear();
+
+    } else if (command == "position") {
+        setPosition(iss);
+
+    } else if (command == "go") {
+        go(iss);
+
+    } else if (command == "stop") {
+        // The search sends its best move
+        pondering = false;
+        _engine.stopSearch();
+
+    } else if (command == "ponderhit") {
+        // The pondering search had no clock, it starts again with one
+        if (pondering) {
+            pondering = false;
+            discardBestMove = true;
+            _engine.stopSearch();
+            discardBestMove = false;
+            startSearch(ponderLimits);
+        }
+
+    } else if (command == "setoption") {
+        setOption(iss);
+
+    } else if (command == "quit") {
+        discardBestMove = true;
+        _engine.stopSearch();
+        _engine.close();
+    }
+}
+
+void UciHandler::send(const std::string& line) {
+    // One write per line, so a socket gets no line cut in two
+    std::string text = line + '\n';
+    std::lock_guard<std::mutex> lock(outputMutex);
+    _out.write(text.data(), text.size());
+    _out.flush();
+    LOG_INFO("uci <- " + line);
+}
+
+/**
+ * position [startpos | fen <FEN>] [moves <move> ...]
+ * On the same starting position, the moves both lists share are kept, the
+ * others are taken back and only the new ones are played.
+ */
+void UciHandler::setPosition(std::istringstream& iss) {
+    std::string token, newBase;
+    iss >> token;
+
+    if (token == "startpos") {
+        newBase = token;
+        iss >> token;
+    } else if (token == "fen") {
+        while (iss >> token && token != "moves") {
+            newBase += (newBase.empty() ? "" : " ") + token;
+        }
+    } else {
+        return;
+    }
+
+    std::vector<std::string> newMoves;
+    if (token == "moves") {
+        while (iss >> token) {
+            newMoves.push_back(token);
+        }
+    }
+
+    size_t common = 0;
+    if (newBase == base) {
+        while (common < moves.size() && common < newMoves.size() &&
+                moves[common] == newMoves[common]) {
+            common++;
+        }
+        for (size_t i = moves.size(); i > common; i--) {
+            _engine.undoMove();
+        }
+    } else {
+        if (newBase == "startpos") {
+            _engine.newGame();
+        } else if (!_engine.setPosition(newBase)) {
+            send("info string Illegal position " + newBase);
+            LOG_ERROR("Invalid FEN " + newBase);
+            _engine.newGame();
+            newBase = "startpos";
+            newMoves.clear();
+        }
+        base = newBase;
+    }
+
+    moves.resize(common);
+    for (size_t i = common; i < newMoves.size(); i++) {
+        _engine.userMove(newMoves[i]);
+        moves.push_back(newMoves[i]);
+    }
+}
+
+/**
+ * go [wtime|btime|winc|binc|movestogo|movetime <ms>] [depth <plies>]
+ *    [nodes <count>] [infinite] [ponder]
+ * Other tokens, as searchmoves and its moves or mate, are skipped.
+ */
+void UciHandler::go(std::istringstream& iss) {
+    static const char *valueTokens[] = {"wtime", "btime", "winc", "binc",
+        "movestogo", "movetime", "depth", "nodes"};
+
+    SearchLimits limits;
+    bool ponder = false;
+    bool white = _engine.sideToMove() == whiteSide;
+
+    std::string token;
+    while (iss >> token) {
+        if (token == "infinite") {
+            limits.infinite = true;
+            continue;
+        }
+        if (token == "ponder") {
+            ponder = true;
+            continue;
+        }
+        if (std::find(std::begin(valueTokens), std::end(valueTokens),
+                token) == std::end(valueTokens)) {
+            continue;
+        }
+
+        double value = 0;
+        iss >> value;
+        if (token == "wtime") {
+            (white ? limits.time : limits.otherTime) = value / 1000;
+        } else if (token == "btime") {
+            (white ? limits.otherTime : limits.time) = value / 1000;
+        } else if (token == (white ? "winc" : "binc")) {
+            limits.increment = value / 1000;
+        } else if (token == "movestogo") {
+            limits.movesToGo = value;
+        } else if (token == "movetime") {
+            limits.moveTime = value / 1000;
+        } else if (token == "depth") {
+            limits.depth = value;
+        } else if (token == "nodes") {
+            limits.nodes = value;
+        }
+    }
+
+    if (ponder) {
+        // Think on the opponent's time until ponderhit or stop
+        ponderLimits = limits;
+        pondering = true;
+
+        SearchLimits infinite;
+        infinite.infinite = true;
+        startSearch(infinite);
+    } else {
+        startSearch(limits);
+    }
+}
+
+/**
+ * setoption name <name> value <value>. Hash reallocates the transposition
+ * table and Threads the helper threads of the search.
+ */
+void UciHandler::setOption(std::istringstream& iss) {
+    std::string token, name, value;
+    iss >> token;
+    while (iss >> token && token != "value") {
+        name += (name.empty() ? "" : " ") + token;
+    }
+    iss >> value;
+
+    if (name == "Hash") {
+        hashMB = std::max(atoi(value.c_str()), 1);
+        _engine.setHashSize(hashMB);
+    } else if (name == "Threads") {
+        threads = std::max(atoi(value.c_str()), 1);
+        _engine.setThreads(threads);
+    } else {
+        send("info string Unknown option " + name);
+    }
+}
+
+void UciHandler::startSearch(const SearchLimits& limits) {
+    _engine.startSearch(limits, [this](const std::string& move) {
+        if (!discardBestMove) {
+            send("bestmove " + move);
+            LOG_INFO("Search stats\n" + _engine.searchStats().toString());
+        }
+    });
+}
@@ -0,0 +1,60 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "./engine.h"
+#include "./logger.h"
+
+/**
+ * UCI frontend of the engine, picked by main when the first command is
+ * "uci". Searches run on the engine's background thread, so stop and
+ * isready are answered while the engine thinks.
+ */
+class UciHandler {
+ private:
+    Engine& _engine;
+    std::ostream& _out;
+
+    // Where the engine's position comes from ("startpos" or a FEN) and the
+    // moves played on it, so "position" only replays what changed
+    std::string base;
+    std::vector<std::string> moves;
+
+    // Limits of the pondering search, used once the ponder move is played
+    SearchLimits ponderLimits;
+    bool pondering = false;
+    // The best move of a search that is thrown away (ponder miss) is not
+    // sent
+    std::atomic<bool> discardBestMove{false};
+
+    // Values of setoption, applied to the engine as they are set
+    int hashMB = DEFAULT_HASH_MB;
+    int threads = DEFAULT_THREADS;
+
+    // bestmove and the info lines are sent from the search thread
+    std::mutex outputMutex;
+    void send(const std::string& line);
+
+    void setPosition(std::istringstream& iss);
+    void go(std::istringstream& iss);
+    void setOption(std::istringstream& iss);
+    void startSearch(const SearchLimits& limits);
+
+ public:
+    /**
+     * @param out where the answers go, a client socket for the games of a
+     * server
+     */
+    explicit UciHandler(Engine& engine, std::ostream& out = std::cout);
+    // Answers the "uci" command
+    void init();
+    // Reads a command from the standard input and handles it
+    void run();
+    void handle(const std::string& buffer);
+};
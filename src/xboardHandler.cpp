@@ -1,55 +1,97 @@
 /* Copyright 2021 DucaPowr Team */
 #include "./xboardHandler.h"
 
-xBoardHandler::xBoardHandler(Engine& engine) : _engine(engine) {
-    std::string line;
-    std::ifstream f(QUOETS_FILE);
-    while (std::getline(f, line))
-    {
-        quotes.push_back(line);
-    }
-    f.close();
+// Read once, the handlers of a server share them
+static const std::vector<std::string>& resignationQuotes(void) {
+    static const std::vector<std::string> quotes = []() {
+        std::vector<std::string> lines;
+        std::string line;
+        std::ifstream f(QUOETS_FILE);
+        while (std::getline(f, line))
+        {
+            lines.push_back(line);
+        }
+        return lines;
+    }();
+    return quotes;
+}
+
+xBoardHandler::xBoardHandler(Engine& engine, std::ostream& out)
+    : _engine(engine), _out(out) {
+    resignationQuotes();
 }
 
-void xBoardHandler::init(void) {
+void xBoardHandler::init(const std::string& firstCommand) {
     std::cout.setf(std::ios::unitbuf);
     std::string buffer;
 
-    // RECV xboard
-    std::getline(std::cin, buffer);
-    if (buffer.compare("xboard") != 0) {
-        _logger.error("xboard command expected - got " + buffer);
+    // RECV xboard, read by main to pick the protocol
+    if (firstCommand.compare("xboard") != 0) {
+        LOG_ERROR("xboard command expected - got " + firstCommand);
         exit(1);
     }
 
     // RECV protover N
     std::getline(std::cin, buffer);
     if (buffer.find("protover") == std::string::npos) {
-        _logger.error("protover N command expected - got " + buffer);
+        LOG_ERROR("protover N command expected - got " + buffer);
         exit(1);
     }
-
-    // SEND feature
-    std::cout << "feature " + std::string(FEATURE_ARGS) << std::endl;
+    handle(buffer);
 }
 
 void xBoardHandler::run(void) {
     std::string buffer;
     std::getline(std::cin, buffer);
+    handle(buffer);
+}
 
-    _logger.info("xboard -> " + buffer);
+void xBoardHandler::handle(const std::string& command) {
+    LOG_INFO("xboard -> " + command);
 
-    std::istringstream iss(buffer);
+    std::istringstream iss(command);
     std::string firstToken;
 
     std::getline(iss, firstToken, ' ');
 
-    if (firstToken == "new") {
+    // The analysis is stopped while the position changes, and restarted
+    // on the new one
+    bool restart = analyzing && needsEngine(firstToken);
+    if (restart) {
+        _engine.stopSearch();
+    }
+
+    if (firstToken == "protover") {
+        // SEND feature
+        _out << "feature " + std::string(FEATURE_ARGS) << std::endl;
+
+    } else if (firstToken == "new") {
         _engine.newGame();
 
         // default observing = true
         observing = true;
 
+        // new drops the depth limit, the clock stays
+        limits.depth = 0;
+        engineMoves = 0;
+
+    } else if (firstToken == "time" || firstToken == "otim") {
+        // Centiseconds left on the clock of the engine / its opponent
+        double centiseconds = 0;
+        iss >> centiseconds;
+        (firstToken == "time" ? limits.time : limits.otherTime) =
+            centiseconds / 100;
+
+    } else if (firstToken == "level") {
+        parseLevel(iss);
+
+    } else if (firstToken == "st") {
+        // Exact number of seconds per move
+        iss >> limits.moveTime;
+
+    } else if (firstToken == "sd") {
+        iss >> limits.depth;
+
     } else if (firstToken == "usermove") {
         std::string move;
         std::getline(iss, move, ' ');
@@ -57,7 +99,7 @@ void xBoardHandler::run(void) {
         // opponent moved
         _engine.userMove(move);
 
-        if (observing) {
+        if (observing && !analyzing) {
             // engine moves
             engineMove();
         }
@@ -69,28 +111,168 @@ void xBoardHandler::run(void) {
         // default observing = true
         observing = true;
 
+    } else if (firstToken == "setboard") {
+        std::string fen;
+        std::getline(iss, fen);
+
+        if (!_engine.setPosition(fen)) {
+            _out << "tellusererror Illegal position" << std::endl;
+            LOG_ERROR("Invalid FEN " + fen);
+        }
+
+    } else if (firstToken == "post" || firstToken == "nopost") {
+        // Thinking output, always on while analyzing
+        posting = firstToken == "post";
+        if (!analyzing) {
+            _engine.setThinkingOutput(posting ? thinkingOutput() : nullptr);
+        }
+
+    } else if (firstToken == "memory") {
+        // Megabytes for the hash tables, sent between games
+        size_t megabytes = DEFAULT_HASH_MB;
+        iss >> megabytes;
+        _engine.setHashSize(megabytes);
+
+    } else if (firstToken == "cores") {
+        unsigned int cores = DEFAULT_THREADS;
+        iss >> cores;
+        _engine.setThreads(cores);
+
+    } else if (firstToken == "undo") {
+        _engine.undoMove();
+
+    } else if (firstToken == "remove") {
+        // Takes back a move of both sides
+        _engine.undoMove();
+        _engine.undoMove();
+
+    } else if (firstToken == "analyze") {
+        analyzing = true;
+        _engine.setThinkingOutput(thinkingOutput());
+        _engine.startSearch(analysisLimits());
+
+    } else if (firstToken == "exit") {
+        analyzing = false;
+        _engine.setThinkingOutput(posting ? thinkingOutput() : nullptr);
+
+    } else if (firstToken == ".") {
+        if (analyzing) {
+            printAnalysisStatus();
+        }
+
     } else if (firstToken == "force") {
         // engine paused, just listen to input
         observing = false;
 
+    } else if (firstToken == "perft" || firstToken == "divide") {
+        // Debug commands: perft <depth> [threads] / divide <depth> [threads]
+        int depth = 1;
+        unsigned int threads = 0;
+        iss >> depth >> threads;
+        _engine.perftReport(depth, firstToken == "divide", threads,
+            _out);
+
+    } else if (firstToken == "stats") {
+        // Debug command: counters of the last search, as xboard comments
+        std::istringstream stats(_engine.searchStats().toString());
+        std::string line;
+        while (std::getline(stats, line)) {
+            _out << "# " << line << '\n';
+        }
+        _out << std::flush;
+
     } else if (firstToken == "quit") {
         // xboard stopped
+        analyzing = false;
         _engine.close();
     }
+
+    if (restart && analyzing) {
+        _engine.startSearch(analysisLimits());
+    }
+}
+
+SearchLimits xBoardHandler::analysisLimits(void) {
+    SearchLimits infinite;
+    infinite.infinite = true;
+    return infinite;
+}
+
+bool xBoardHandler::needsEngine(const std::string& command) {
+    static const char *commands[] = {"new", "usermove", "setboard", "undo",
+        "remove", "exit", "perft", "divide", "stats", "go", "memory", "cores",
+        "quit"};
+
+    for (const char *c : commands) {
+        if (command == c) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::function<void(const std::string&)> xBoardHandler::thinkingOutput(void) {
+    return [this](const std::string& line) {
+        send(line);
+    };
+}
+
+// stat01: time nodes ply mvleft mvtot, the moves are not tracked
+void xBoardHandler::printAnalysisStatus(void) {
+    double seconds;
+    U64 nodes;
+    int depth;
+    _engine.searchProgress(&seconds, &nodes, &depth);
+
+    send("stat01: " + std::to_string(static_cast<int>(seconds * 100)) +
+        ' ' + std::to_string(nodes) + ' ' + std::to_string(depth) + " 0 0");
+}
+
+void xBoardHandler::send(const std::string& line) {
+    // One write per line, so a socket gets no line cut in two
+    std::string text = line + '\n';
+    std::lock_guard<std::mutex> lock(outputMutex);
+    _out.write(text.data(), text.size());
+    _out.flush();
+}
+
+/**
+ * level MPS BASE INC: MPS moves in BASE minutes (or "minutes:seconds"),
+ * 0 moves for the whole game, and INC seconds added after every move.
+ */
+void xBoardHandler::parseLevel(std::istringstream& iss) {
+    std::string base;
+    iss >> movesPerSession >> base >> limits.increment;
+
+    // level and st exclude each other
+    limits.moveTime = 0;
+    limits.movesToGo = 0;
+    size_t colon = base.find(':');
+    limits.time = atof(base.c_str()) * 60;
+    if (colon != std::string::npos) {
+        limits.time += atof(base.c_str() + colon + 1);
+    }
 }
 
 void xBoardHandler::engineMove(void) {
-    std::string move = _engine.move();
+    if (movesPerSession > 0) {
+        limits.movesToGo = movesPerSession - engineMoves % movesPerSession;
+    }
+    engineMoves++;
+
+    std::string move = _engine.move(limits);
     if (move == "resign") {
         move = getResignationString();
     } else {
         move = "move " + move;
     }
-    std::cout <<  move << std::endl;
-    _logger.info("xboard <- " + move);
+    _out <<  move << std::endl;
+    LOG_INFO("xboard <- " + move);
+    LOG_INFO("Search stats\n" + _engine.searchStats().toString());
 }
 
 std::string xBoardHandler::getResignationString(void) {
+    const std::vector<std::string>& quotes = resignationQuotes();
     unsigned int seed = static_cast <int64_t> (time(NULL));
     int randIndex = rand_r(&seed) % quotes.size();
     std::string result = (_engine.sideToMove()) ? "1-0" : "0-1";
@@ -2,7 +2,9 @@
 #pragma once
 
 #include <stdio.h>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 
 #include "./engine.h"
@@ -11,15 +13,42 @@
 class xBoardHandler {
  private:
     Engine& _engine;
-    Logger _logger;
+    std::ostream& _out;
 
     bool observing = true;
 
+    // Thinking output is on (post), and the engine is in analyze mode
+    bool posting = false;
+    bool analyzing = false;
+    // Commands that need the engine while an analysis runs on it
+    bool needsEngine(const std::string& command);
+    void printAnalysisStatus();
+
+    // The thinking lines of an analysis come from the search thread, and
+    // stat01 from the handler, so both are written under the lock
+    std::mutex outputMutex;
+    void send(const std::string& line);
+    std::function<void(const std::string&)> thinkingOutput();
+    static SearchLimits analysisLimits();
+
+    // Time control, from the time, otim, level, st and sd commands
+    SearchLimits limits;
+    // Moves per session of the level command, 0 for the whole game
+    int movesPerSession = 0;
+    // Moves the engine played since new, to count the moves to go
+    int engineMoves = 0;
+    void parseLevel(std::istringstream& iss);
+
     void engineMove();
-    std::vector<std::string> quotes;
     std::string getResignationString();
  public:
-    explicit xBoardHandler(Engine& engine);
-    void init();
+    /**
+     * @param out where the answers go, a client socket for the games of a
+     * server
+     */
+    explicit xBoardHandler(Engine& engine, std::ostream& out = std::cout);
+    void init(const std::string& firstCommand);
+    // Reads a command from the standard input and handles it
     void run();
+    void handle(const std::string& command);
 };
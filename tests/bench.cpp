@@ -0,0 +1,199 @@
+/* Copyright 2021 DucaPowr Team */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/board.h"
+#include "../src/moveGen.h"
+
+#define DEBUG_FILE_NAME "bench.debug"
+
+// Calls of a kernel on every position
+#define REPETITIONS 100
+
+std::ofstream Logger::debugFile(DEBUG_FILE_NAME);
+
+struct BenchPosition {
+    CompactPosition pos;
+    // A move that can be played in the position, and its san=0 encoding
+    uint16_t move;
+    std::string san;
+    std::string fen;
+};
+
+// Keeps the compiler from dropping the results of the timed calls
+static volatile U64 sink;
+
+/**
+ * Plays random games from the initial position and stores every position
+ * reached. The seed is fixed, so every run times the same positions.
+ */
+static std::vector<BenchPosition> randomPositions(size_t count) {
+    std::vector<BenchPosition> positions;
+    Board board;
+    Generator generator(board);
+    std::mt19937 rng(20211);
+
+    while (positions.size() < count) {
+        board.init();
+
+        for (int ply = 0; ply < 100 && positions.size() < count; ply++) {
+            uint16_t moves[MAX_MOVES_AT_STEP];
+            uint16_t movesLen = 0;
+            generator.generateMoves(moves, &movesLen);
+
+            if (movesLen == 0) {
+                break;
+            }
+
+            BenchPosition p;
+            board.getPosition(&p.pos);
+            p.move = moves[rng() % movesLen];
+            p.san = board.convertMoveToSan(p.move);
+            p.fen = board.toFEN();
+            positions.push_back(p);
+
+            board.applyMove(p.move);
+
+            // Stop the game once a king is captured
+            if (!board.getKingBB(whiteSide) || !board.getKingBB(blackSide)) {
+                break;
+            }
+        }
+    }
+
+    return positions;
+}
+
+/**
+ * Times a kernel on every position and prints "<name> <ns/op>".
+ *
+ * @param setup called before the kernel runs on a position, not timed
+ */
+template <typename Setup, typename Kernel>
+static void bench(const char *name, Board& board,
+        const std::vector<BenchPosition>& positions, Setup setup,
+        Kernel kernel) {
+    std::chrono::steady_clock::duration total(0);
+    U64 result = 0;
+
+    for (const BenchPosition& p : positions) {
+        board.setPosition(p.pos);
+        setup(p);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < REPETITIONS; i++) {
+            result += kernel(p);
+        }
+        total += std::chrono::steady_clock::now() - start;
+    }
+
+    sink = result;
+    double ns = std::chrono::duration<double, std::nano>(total).count() /
+        (positions.size() * REPETITIONS);
+    printf("%s %.1f\n", name, ns);
+}
+
+/**
+ * Usage: ./bench [positions]
+ * Prints one "<kernel> <ns/op>" line per kernel.
+ */
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? atol(argv[1]) : 10000;
+    std::vector<BenchPosition> positions = randomPositions(count);
+
+    Board board;
+    board.init();
+    Generator generator(board);
+
+    auto noSetup = [](const BenchPosition&) {};
+
+    // The square and the occupancy for the rook lookups
+    uint16_t rank = 0, file = 0;
+    U64 occ = 0, friendPieceBB = 0;
+    auto rookSetup = [&](const BenchPosition&) {
+        Side side = board.sideToMove;
+        U64 rookBB = board.getRookBB(side) | board.getKingBB(side);
+        uint16_t square = getSquareIndex(rookBB);
+        rank = square / 8;
+        file = square % 8;
+        occ = board.getAllBB() & ~(1ULL << square);
+        friendPieceBB = board.getPieceBB(side);
+    };
+
+    printf("# kernel ns/op\n");
+
+    bench("generateMoves", board, positions, noSetup,
+        [&](const BenchPosition&) {
+            uint16_t moves[MAX_MOVES_AT_STEP];
+            uint16_t movesLen = 0;
+            generator.generateMoves(moves, &movesLen);
+            return (U64) movesLen;
+        });
+
+    bench("getAttackBB", board, positions, noSetup,
+        [&](const BenchPosition&) {
+            return generator.getAttackBB(board.sideToMove);
+        });
+
+    bench("getPositionedBishopAttackBB", board, positions, noSetup,
+        [&](const BenchPosition&) {
+            Side side = board.sideToMove;
+            return generator.getPositionedBishopAttackBB(side,
+                board.getBishopBB(side) | board.getQueenBB(side));
+        });
+
+    bench("getRookRankAttackBB", board, positions, rookSetup,
+        [&](const BenchPosition&) {
+            return generator.getRookRankAttackBB(rank, file, occ,
+                friendPieceBB);
+        });
+
+    bench("getRookFileAttackBB", board, positions, rookSetup,
+        [&](const BenchPosition&) {
+            return generator.getRookFileAttackBB(rank, file, occ,
+                friendPieceBB);
+        });
+
+    bench("applyMove+undoMove", board, positions, noSetup,
+        [&](const BenchPosition& p) {
+            board.applyMove(p.move);
+            board.undoMove();
+            return (U64) 0;
+        });
+
+    // With both attack caches filled, as in the search
+    bench("eval", board, positions,
+        [&](const BenchPosition&) {
+            generator.getAttackBB(whiteSide);
+            generator.getAttackBB(blackSide);
+        },
+        [&](const BenchPosition&) {
+            return (U64) board.eval();
+        });
+
+    bench("hash", board, positions, noSetup,
+        [&](const BenchPosition&) {
+            return board.hash();
+        });
+
+    bench("convertSanToMove", board, positions, noSetup,
+        [&](const BenchPosition& p) {
+            return (U64) board.convertSanToMove(p.san);
+        });
+
+    bench("setFromFEN", board, positions, noSetup,
+        [&](const BenchPosition& p) {
+            return (U64) board.setFromFEN(p.fen);
+        });
+
+    bench("toFEN", board, positions, noSetup,
+        [&](const BenchPosition&) {
+            return (U64) board.toFEN().size();
+        });
+
+    return 0;
+}
@@ -1,5 +1,13 @@
 /* Copyright 2021 DucaPowr Team */
 #include "testGenerator.h"
+#include "testPerft.h"
+#include "testFen.h"
+#include "testNetwork.h"
+#include "testBook.h"
+#include "testEndgame.h"
+#include "testTablebase.h"
+#include "testUci.h"
+#include "testTranspositionTable.h"
 #include <iostream>
 
 #define DEBUG_FILE_NAME "test.debug"
@@ -8,4 +16,12 @@ std::ofstream Logger::debugFile(DEBUG_FILE_NAME);
 
 int main() {
     testGenerator();
+    testPerft();
+    testFen();
+    testNetwork();
+    testBook();
+    testEndgame();
+    testTablebase();
+    testUci();
+    testTranspositionTable();
 }
@@ -0,0 +1,100 @@
+/* Copyright 2021 DucaPowr Team */
+#include "testBook.h"
+
+#include <fstream>
+
+#include "../src/book.h"
+
+// Appends a book entry, big endian
+static void writeBookEntry(std::ofstream& out, U64 key, uint16_t move,
+        uint16_t weight) {
+    uint8_t entry[BOOK_ENTRY_SIZE] = {0};
+    for (int i = 0; i < 8; i++) {
+        entry[i] = key >> (56 - 8 * i);
+    }
+    entry[8] = move >> 8;
+    entry[9] = move;
+    entry[10] = weight >> 8;
+    entry[11] = weight;
+    out.write(reinterpret_cast<char *>(entry), BOOK_ENTRY_SIZE);
+}
+
+static void testBookProbe(Board& board) {
+    Generator generator(board);
+    MoveChecker checker(board);
+
+    // Without checks the keys are the ones of the Polyglot specification
+    board.init();
+    assert(Book::key(board) == 0x463b96181691fc9cULL);
+    loadFen(board,
+        "rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2 +0+0");
+    assert(Book::key(board) == 0x0756b94461c50fb0ULL);
+    loadFen(board,
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3 +0+0");
+    assert(Book::key(board) == 0x22a48b5a8e47ff78ULL);
+    loadFen(board,
+        "rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4 +0+0");
+    assert(Book::key(board) == 0x00fdd303c946bdd9ULL);
+    loadFen(board,
+        "rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3 +0+0");
+    assert(Book::key(board) == 0x3c8123ea7b067637ULL);
+
+    // Transpositions share a key, the check counters and the side to move
+    // are part of it
+    loadFen(board,
+        "rnbqkbnr/pppppppp/8/8/8/5N2/PPPPPPPP/RNBQKB1R b KQkq - 1 1 +0+0");
+    U64 nf3 = Book::key(board);
+    board.init();
+    board.applyMove(board.convertSanToMove("g1f3"));
+    assert(Book::key(board) == nf3);
+    loadFen(board,
+        "rnbqkbnr/pppppppp/8/8/8/5N2/PPPPPPPP/RNBQKB1R b KQkq - 1 1 +1+0");
+    assert(Book::key(board) != nf3);
+    loadFen(board,
+        "rnbqkbnr/pppppppp/8/8/8/5N2/PPPPPPPP/RNBQKB1R w KQkq - 1 1 +0+0");
+    assert(Book::key(board) != nf3);
+
+    // Castling is the king taking its rook, promotions count from the
+    // knight
+    assert(Book::toPolyglotMove(board.convertSanToMove("e1g1")) == 0x107);
+    loadFen(board, "4k3/1P6/8/8/8/8/8/4K3 w - - 0 1");
+    assert(Book::toPolyglotMove(board.convertSanToMove("b7b8q")) == 0x4c79);
+
+    board.init();
+    U64 start = Book::key(board);
+    const char *fileName = "test.bin";
+    {
+        std::ofstream out(fileName, std::ios::binary);
+        // e2e4 is the only move with a weight
+        writeBookEntry(out, start, 0x31c, 1);
+        writeBookEntry(out, start, 0x195, 0);
+        writeBookEntry(out, ~0ULL, 0x31c, 1);
+    }
+    // The entries are sorted by key
+    assert(start < ~0ULL);
+
+    bool opened = Book::open(fileName);
+    assert(opened);
+    for (int i = 0; i < 4; i++) {
+        assert(Book::probe(board, generator, checker) ==
+            board.convertSanToMove("e2e4"));
+    }
+    board.applyMove(board.convertSanToMove("e2e4"));
+    assert(Book::probe(board, generator, checker) == 0xffff);
+    Book::close();
+    remove(fileName);
+
+    opened = Book::open("missing.bin");
+    assert(!opened);
+    assert(Book::probe(board, generator, checker) == 0xffff);
+}
+
+void testBook(void) {
+    Board board;
+    board.init();
+
+    std::cout << "testBookProbe()\n";
+    std::cout.flush();
+    testBookProbe(board);
+    std::cout << "DONE\n";
+}
@@ -0,0 +1,53 @@
+/* Copyright 2021 DucaPowr Team */
+#include "testEndgame.h"
+
+#include "../src/endgame.h"
+
+static void testEndgameProbe(Board& board) {
+    Endgame::init();
+    int score;
+
+    // The side to move loses the opposition: white wins if it is black,
+    // black draws if it is white
+    loadFen(board, "8/4k3/8/4K3/4P3/8/8/8 b - - 0 1");
+    bool found = Endgame::probe(board, &score);
+    assert(found && score < -KNOWN_WIN_SCORE / 2);
+    loadFen(board, "8/4k3/8/4K3/4P3/8/8/8 w - - 0 1");
+    found = Endgame::probe(board, &score);
+    assert(found && score == 0);
+
+    // The first one, mirrored and with the colours swapped
+    loadFen(board, "8/8/8/3p4/3k4/8/3K4/8 w - - 0 1");
+    found = Endgame::probe(board, &score);
+    assert(found && score < -KNOWN_WIN_SCORE / 2);
+
+    // An undefended pawn is taken
+    loadFen(board, "8/8/8/3k4/4P3/8/8/K7 b - - 0 1");
+    found = Endgame::probe(board, &score);
+    assert(found && score == 0);
+
+    // A drawn position, unless the pawn gives the third check
+    loadFen(board, "8/8/8/8/3k4/8/4P3/4K3 w - - 0 1 +0+0");
+    found = Endgame::probe(board, &score);
+    assert(found);
+    loadFen(board, "8/8/8/8/3k4/8/4P3/4K3 w - - 0 1 +2+0");
+    found = Endgame::probe(board, &score);
+    assert(found && score > KNOWN_WIN_SCORE / 2);
+
+    loadFen(board, "8/8/8/3k4/8/8/8/K7 w - - 0 1 +1+2");
+    found = Endgame::probe(board, &score);
+    assert(found && score == 0);
+    loadFen(board, "8/8/8/3k4/8/8/8/KN6 w - - 0 1");
+    found = Endgame::probe(board, &score);
+    assert(!found);
+}
+
+void testEndgame(void) {
+    Board board;
+    board.init();
+
+    std::cout << "testEndgameProbe()\n";
+    std::cout.flush();
+    testEndgameProbe(board);
+    std::cout << "DONE\n";
+}
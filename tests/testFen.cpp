@@ -0,0 +1,118 @@
+/* Copyright 2021 DucaPowr Team */
+#include "testFen.h"
+
+#include <string>
+
+// Loads FENs with check counters and writes them back, every field kept
+static void testFenRoundTrip(Board& board) {
+    static const char *fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 +0+0",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 7 1 "
+            "+1+2",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8 +2+0",
+        "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1 +0+1",
+        "rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 3 +0+0",
+    };
+
+    for (const char *fen : fens) {
+        loadFen(board, fen);
+        if (board.toFEN() != fen) {
+            std::cerr << "Test failed\n" << "fen=" << fen << "\ntoFEN=" <<
+                board.toFEN() << '\n';
+            assert(0);
+        }
+    }
+
+    // Checks left, as X-FEN writes them, before the move counters
+    CompactPosition pos;
+    loadFen(board, "4k3/8/8/8/8/8/8/4K3 b - - 2+1 0 40");
+    board.getPosition(&pos);
+    assert(pos.checkCount[whiteSide] == 2 && pos.checkCount[blackSide] == 1);
+    assert(board.toFEN() == "4k3/8/8/8/8/8/8/4K3 b - - 0 40 +1+2");
+
+    // The move counters follow the moves played, and the halfmove clock
+    // starts again after a pawn move or a capture
+    loadFen(board, "4k3/8/8/8/8/2n5/1P6/4K3 b - - 12 40");
+    board.applyMove(board.convertSanToMove("e8d8"));
+    board.applyMove(board.convertSanToMove("e1d1"));
+    assert(board.toFEN() == "3k4/8/8/8/8/2n5/1P6/3K4 b - - 14 41 +0+0");
+    board.applyMove(board.convertSanToMove("c3b5"));
+    board.applyMove(board.convertSanToMove("b2b4"));
+    assert(board.toFEN() == "3k4/8/8/1n6/1P6/8/8/3K4 b - b3 0 42 +0+0");
+    board.applyMove(board.convertSanToMove("d8c7"));
+    board.applyMove(board.convertSanToMove("d1c2"));
+    board.applyMove(board.convertSanToMove("b5d4"));
+    board.applyMove(board.convertSanToMove("c2c3"));
+    board.applyMove(board.convertSanToMove("d4b3"));
+    board.applyMove(board.convertSanToMove("c3b3"));
+    assert(board.toFEN() == "8/2k5/8/8/1P6/1K6/8/8 b - - 0 45 +0+0");
+
+    // Taking the moves back restores the clock
+    board.undoMove();
+    board.undoMove();
+    assert(board.toFEN() == "8/2k5/8/8/1P1n4/2K5/8/8 b - - 4 44 +0+0");
+    for (int i = 0; i < 8; i++) {
+        board.undoMove();
+    }
+    assert(board.toFEN() == "4k3/8/8/8/8/2n5/1P6/4K3 b - - 12 40 +0+0");
+
+    bool tooManyChecks = board.setFromFEN("4k3/8/8/8/8/8/8/4K3 w - - 0 1 +4+0");
+    bool oneCounter = board.setFromFEN("4k3/8/8/8/8/8/8/4K3 w - - 0 1 +1");
+    assert(!tooManyChecks && !oneCounter);
+}
+
+// Boards that cannot exist are rejected, and the board is left as it was
+static void testFenRejected(Board& board) {
+    static const char *fens[] = {
+        // 16 files, 7 files, 7 ranks, 9 ranks
+        "88/8/8/8/8/8/8/4K3 w - - 0 1",
+        "4k3/8/8/8/8/8/8/4K2 w - - 0 1",
+        "4k3/8/8/8/8/8/4K3 w - - 0 1",
+        "4k3/8/8/8/8/8/8/8/4K3 w - - 0 1",
+        "4k3/8/8/8/8/8/8/4K3p w - - 0 1",
+        // Kings missing or doubled
+        "8/8/8/8/8/8/8/8 w - - 0 1",
+        "8/8/8/8/8/8/8/4K3 w - - 0 1",
+        "4k3/8/8/8/8/8/8/3KK3 w - - 0 1",
+        // Pawns on the first and the last rank
+        "4k3/8/8/8/8/8/8/P3K3 w - - 0 1",
+        "p3k3/8/8/8/8/8/8/4K3 w - - 0 1",
+        // Side to move not followed by a space
+        "4k3/8/8/8/8/8/8/4K3 w",
+        "4k3/8/8/8/8/8/8/4K3 wb - - 0 1",
+        // Castling rights without the king or the rook at home
+        "r3k2r/8/8/8/8/8/8/R4K1R w KQkq - 0 1",
+        "r3k2r/8/8/8/8/8/8/R3K3 w K - 0 1",
+        "r3k2r/8/8/8/8/8/8/4K2R w Q - 0 1",
+        "r3k3/8/8/8/8/8/8/R3K2R w k - 0 1",
+        "4k2r/8/8/8/8/8/8/R3K2R w q - 0 1",
+        // En passant square off ranks 3 and 6
+        "4k3/8/8/8/3pP3/8/8/4K3 b - e4 0 1",
+        "4k3/8/8/8/3pP3/8/8/4K3 b - e9 0 1",
+    };
+
+    loadFen(board, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    std::string before = board.toFEN();
+    for (const char *fen : fens) {
+        bool valid = board.setFromFEN(fen);
+        if (valid || board.toFEN() != before) {
+            std::cerr << "Test failed\n" << "accepted fen=" << fen << '\n';
+            assert(0);
+        }
+    }
+}
+
+void testFen(void) {
+    Board board;
+    board.init();
+
+    std::cout << "testFenRoundTrip()\n";
+    std::cout.flush();
+    testFenRoundTrip(board);
+    std::cout << "DONE\n";
+
+    std::cout << "testFenRejected()\n";
+    std::cout.flush();
+    testFenRejected(board);
+    std::cout << "DONE\n";
+}
@@ -0,0 +1,8 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include "./utils.h"
+#include "../src/utils.h"
+#include "../src/board.h"
+
+void testFen();
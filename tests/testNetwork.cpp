@@ -0,0 +1,124 @@
+/* Copyright 2021 DucaPowr Team */
+#include "testNetwork.h"
+
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include "../src/nnue.h"
+
+// Writes a network of random weights, in the format of Network::load()
+static void writeTestNetwork(const char *fileName) {
+    std::mt19937 rng(27);
+    std::uniform_int_distribution<int> weight(-128, 127);
+    uint32_t header[3] = {0x41435544, NNUE_INPUTS, NNUE_HIDDEN};
+    std::vector<int16_t> features(NNUE_HIDDEN * (NNUE_INPUTS + 1));
+    std::vector<int8_t> output(2 * NNUE_HIDDEN);
+    int32_t outputBias = weight(rng);
+
+    for (int16_t& w : features) {
+        w = weight(rng);
+    }
+    for (int8_t& w : output) {
+        w = weight(rng);
+    }
+
+    // The biases come first, followed by the weights of every input
+    std::ofstream out(fileName, std::ios::binary);
+    out.write(reinterpret_cast<char *>(header), sizeof(header));
+    out.write(reinterpret_cast<char *>(features.data()),
+        features.size() * sizeof(int16_t));
+    out.write(reinterpret_cast<char *>(output.data()), output.size());
+    out.write(reinterpret_cast<char *>(&outputBias), sizeof(outputBias));
+}
+
+// Compares both halves of the board's accumulator with a fresh one
+static void checkAccumulator(Board& board, uint16_t move) {
+    CompactPosition pos;
+    board.getPosition(&pos);
+    Accumulator expected;
+    Network::refresh(expected, pos.pieceBB, pos.checkCount);
+
+    if (memcmp(expected.acc, board.getAccumulator().acc,
+            sizeof(expected.acc))) {
+        std::cerr << "Test failed\n" << "move=" <<
+            board.convertMoveToSan(move) << '\n' << board.toString() << '\n';
+        assert(0);
+    }
+}
+
+/**
+ * Walks the legal move tree, counting the checks as the engine does, and
+ * checks that the incrementally updated accumulators match a refresh after
+ * every move and every take back.
+ */
+static void checkAccumulators(Board& board, Generator& generator,
+        MoveChecker& checker, Perft& perft, int depth) {
+    if (depth == 0) {
+        return;
+    }
+
+    uint16_t moves[MAX_MOVES_AT_STEP];
+    uint16_t movesLen = 0;
+    perft.legalMoves(moves, &movesLen);
+
+    for (int i = 0; i < movesLen; ++i) {
+        board.applyMove(moves[i]);
+        bool check = checker.isCheck(
+            generator.getAttackBB(otherSide(board.sideToMove)));
+        if (check) {
+            board.updateCheckCounter(1, board.sideToMove);
+        }
+        checkAccumulator(board, moves[i]);
+
+        checkAccumulators(board, generator, checker, perft, depth - 1);
+
+        if (check) {
+            board.updateCheckCounter(-1, board.sideToMove);
+        }
+        board.undoMove();
+        checkAccumulator(board, moves[i]);
+    }
+}
+
+/**
+ * Promotions, castling, en passant and third checks, on a network of
+ * random weights. The network is closed again for the other tests.
+ */
+static void testNetworkAccumulators(Board& board) {
+    static const char *fens[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1 "
+            "+1+0",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1 +0+1",
+        "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1 +2+1",
+        "r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1 +2+2",
+    };
+    const char *fileName = "test.nnue";
+    writeTestNetwork(fileName);
+    bool loaded = Network::load(fileName);
+    remove(fileName);
+    assert(loaded);
+
+    Generator generator(board);
+    MoveChecker checker(board);
+    Perft perft(board, generator, checker);
+    for (const char *fen : fens) {
+        loadFen(board, fen);
+        checkAccumulators(board, generator, checker, perft, 3);
+    }
+
+    Network::close();
+    board.init();
+}
+
+void testNetwork(void) {
+    Board board;
+    board.init();
+
+    std::cout << "testNetworkAccumulators()\n";
+    std::cout.flush();
+    testNetworkAccumulators(board);
+    std::cout << "DONE\n";
+}
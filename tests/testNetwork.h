@@ -0,0 +1,11 @@
+/* Copyright 2021 DucaPowr Team */
+#pragma once
+
+#include "./utils.h"
+#include "../src/utils.h"
+#include "../src/moveGen.h"
+#include "../src/moveChecker.h"
+#include "../src/board.h"
+#include "../src/perft.h"
+
+void testNetwork();
@@ -0,0 +1,159 @@
+/* Copyright 2021 DucaPowr Team */
+#include "testPerft.h"
+
+#include <cstring>
+#include <iostream>
+
+// Threads for the perft runs, 0 for all hardware threads
+#define PERFT_THREADS 0
+#define TEST_PERFT_HASH_MB 16
+
+struct PerftCase {
+    const char *fen;
+    int depth;
+    U64 nodes;
+};
+
+/**
+ * Positions and node counts from the Chess Programming Wiki "Perft Results"
+ * page, followed by a set of edge cases for castling, en passant,
+ * promotions and discovered checks.
+ */
+static const PerftCase perftCases[] = {
+    // Initial position
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 1, 20},
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 2, 400},
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 3, 8902},
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4, 197281},
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5,
+        4865609},
+    // Kiwipete
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        1, 48},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        2, 2039},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        3, 97862},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        4, 4085603},
+    // Rook endgame with en passant captures that expose the king
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 1, 14},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 3, 2812},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624},
+    // Promotions, castling through attacked squares
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 1,
+        6},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 2,
+        264},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 3,
+        9467},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4,
+        422333},
+    // Underpromotions with capture
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 1, 44},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 2, 1486},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3, 62379},
+    // Quiet middlegame
+    {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - "
+        "0 10", 1, 46},
+    {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - "
+        "0 10", 3, 89890},
+    // En passant that would leave the king in check
+    {"3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888},
+    {"8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133},
+    // En passant that gives check
+    {"8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467},
+    // Castling that gives check
+    {"5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072},
+    {"3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 6, 803711},
+    // Castling rights lost by moves and captures
+    {"r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206},
+    // Castling through attacked squares
+    {"r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476},
+    // Promotions out of check, with check and to every piece
+    {"2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001},
+    {"4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342},
+    {"8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683},
+    // Discovered check
+    {"8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658},
+    // Stalemates and checkmates
+    {"K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217},
+    {"8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584},
+    {"8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527},
+};
+
+static void testPerftCounts(Board& board) {
+    for (const PerftCase& c : perftCases) {
+        loadFen(board, c.fen);
+
+        U64 nodes = parallelPerft(board, c.depth, PERFT_THREADS,
+            TEST_PERFT_HASH_MB, NULL);
+        if (nodes != c.nodes) {
+            std::cerr << "Test failed\n" << "fen=" << c.fen <<
+                "\ndepth=" << c.depth << "\nexpected=" << c.nodes <<
+                "\nnodes=" << nodes << '\n';
+            assert(0);
+        }
+    }
+}
+
+/**
+ * Walks the legal move tree and checks that undoMove() restores the piece
+ * bitboards, the flags and the hash after every move.
+ */
+static void checkMakeUnmake(Board& board, Perft& perft, int depth) {
+    if (depth == 0) {
+        return;
+    }
+
+    uint16_t moves[MAX_MOVES_AT_STEP];
+    uint16_t movesLen = 0;
+    perft.legalMoves(moves, &movesLen);
+
+    for (int i = 0; i < movesLen; ++i) {
+        CompactPosition before, after;
+        board.getPosition(&before);
+        U64 flags = board.getFlags();
+        U64 hash = board.hash();
+
+        board.applyMove(moves[i]);
+        checkMakeUnmake(board, perft, depth - 1);
+        board.undoMove();
+
+        board.getPosition(&after);
+        if (memcmp(before.pieceBB, after.pieceBB, sizeof(before.pieceBB)) ||
+                before.sideToMove != after.sideToMove ||
+                flags != board.getFlags() || hash != board.hash()) {
+            std::cerr << "Test failed\n" << "move=" <<
+                board.convertMoveToSan(moves[i]) << '\n' <<
+                board.toString() << '\n';
+            assert(0);
+        }
+    }
+}
+
+static void testMakeUnmake(Board& board) {
+    Generator generator(board);
+    MoveChecker checker(board);
+    Perft perft(board, generator, checker);
+
+    for (const PerftCase& c : perftCases) {
+        loadFen(board, c.fen);
+        checkMakeUnmake(board, perft, 3);
+    }
+}
+
+void testPerft(void) {
+    Board board;
+    board.init();
+
+    std::cout << "testPerftCounts()\n";
+    std::cout.flush();
+    testPerftCounts(board);
+    std::cout << "DONE\n";
+
+    std::cout << "testMakeUnmake()\n";
+    std::cout.flush();
+    testMakeUnmake(board);
+    std::cout << "DONE\n";
+}
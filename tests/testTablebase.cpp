@@ -0,0 +1,106 @@
+/* Copyright 2021 DucaPowr Team */
+#include "testTablebase.h"
+
+#include <cstring>
+#include <vector>
+
+#include "../src/tablebase.h"
+
+static void testTablebaseLayout(Board& board) {
+    TablebaseLayout layout;
+    bool parsed = layout.parse("KQQQvK") || layout.parse("QvK") ||
+        layout.parse("KQK");
+    assert(!parsed);
+
+    // The letters are sorted, the kings first
+    parsed = layout.parse("KPRvK");
+    assert(parsed && layout.name == "KRPvK");
+    assert(layout.size == 18ULL * 64 * 64 * 64 * 64);
+
+    CompactPosition pos, decoded;
+    loadFen(board, "8/8/3k4/8/2R5/8/4P3/K7 b - - 0 1 +2+1");
+    board.getPosition(&pos);
+    bool valid = layout.decode(layout.index(pos), &decoded);
+    assert(valid);
+    assert(!memcmp(pos.pieceBB, decoded.pieceBB, sizeof(pos.pieceBB)));
+    assert(decoded.sideToMove == blackSide &&
+        decoded.checkCount[whiteSide] == 1 &&
+        decoded.checkCount[blackSide] == 2);
+
+    // Twin pieces only in increasing order, pawns never on the last ranks
+    parsed = layout.parse("KvKNN");
+    assert(parsed);
+    valid = layout.decode(((0 * 64 + 1) * 64 + 2) * 64 + 3, &decoded);
+    assert(valid);
+    valid = layout.decode(((0 * 64 + 1) * 64 + 3) * 64 + 2, &decoded);
+    assert(!valid);
+    parsed = layout.parse("KPvK");
+    assert(parsed);
+    valid = layout.decode((0 * 64 + 60) * 64 + 1, &decoded);
+    assert(!valid);
+
+    // Without tables nothing is found
+    int score;
+    bool found = Tablebases::probe(board, &score);
+    assert(!found);
+}
+
+/**
+ * Writes a KPvK table of made up values, with runs of every length and
+ * literals, maps it and reads every position back.
+ */
+static void testTablebaseRoundTrip(void) {
+    TablebaseLayout layout;
+    bool parsed = layout.parse("KPvK");
+    assert(parsed);
+
+    std::vector<int8_t> values(layout.size);
+    uint64_t index = 0;
+    for (int length = 1; index < layout.size; length = length % 300 + 1) {
+        int8_t value = static_cast<int8_t>((index * 37 + length) % 255 - 127);
+        for (int i = 0; i < length && index < layout.size; i++) {
+            // Short runs of literals between the long runs
+            values[index++] = length < 4 ? static_cast<int8_t>(value + i) :
+                value;
+        }
+    }
+
+    const char *fileName = "test.dtb";
+    bool written = Tablebases::write(fileName, layout, values.data());
+    bool added = Tablebases::add(fileName);
+    remove(fileName);
+    assert(written && added);
+    assert(Tablebases::maxPieces() == 3);
+
+    for (index = 0; index < layout.size; index++) {
+        CompactPosition pos;
+        if (!layout.decode(index, &pos)) {
+            continue;
+        }
+
+        int stored;
+        bool found = Tablebases::value(pos, &stored);
+        if (!found || stored != values[index]) {
+            std::cerr << "Test failed\n" << "index=" << index <<
+                "\nexpected=" << static_cast<int>(values[index]) <<
+                "\nstored=" << stored << '\n';
+            assert(0);
+        }
+    }
+    Tablebases::close();
+}
+
+void testTablebase(void) {
+    Board board;
+    board.init();
+
+    std::cout << "testTablebaseLayout()\n";
+    std::cout.flush();
+    testTablebaseLayout(board);
+    std::cout << "DONE\n";
+
+    std::cout << "testTablebaseRoundTrip()\n";
+    std::cout.flush();
+    testTablebaseRoundTrip();
+    std::cout << "DONE\n";
+}
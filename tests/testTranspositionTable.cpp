@@ -0,0 +1,155 @@
+/* Copyright 2021 DucaPowr Team */
+#include "testTranspositionTable.h"
+
+#include <climits>
+#include <thread>
+#include <vector>
+
+#include "../src/transpositionTable.h"
+
+// Keys of the same slot in any table of up to 2^32 entries
+#define KEY_A 0x0123456789ABCDEFULL
+#define KEY_B 0xFEDCBA9889ABCDEFULL
+
+static bool sameEntry(const TTEntry& a, const TTEntry& b) {
+    return a.score == b.score && a.move == b.move && a.depth == b.depth &&
+        a.bound == b.bound;
+}
+
+// Every field comes back as stored, the score with its sign
+static void testTranspositionTableRoundTrip(void) {
+    TranspositionTable table(1);
+    const std::vector<TTEntry> stored = {
+        {0, 0x31c, 1, BOUND_EXACT},
+        {-1, 0xffff, 255, BOUND_LOWER},
+        {1, 0x195, 7, BOUND_UPPER},
+        {-30000, 0x4c79, 12, BOUND_EXACT},
+        {INT_MAX, 0x8001, 3, BOUND_LOWER},
+        {INT_MIN, 0x7ffe, 2, BOUND_UPPER},
+    };
+
+    for (size_t i = 0; i < stored.size(); i++) {
+        U64 key = KEY_A + (i << 40);
+        const TTEntry& e = stored[i];
+        table.store(key, e.score, e.move, e.depth, e.bound);
+
+        TTEntry probed;
+        bool found = table.probe(key, &probed);
+        if (!found || !sameEntry(probed, e)) {
+            std::cerr << "Test failed\n" << "score=" << e.score <<
+                " move=" << e.move << " depth=" << e.depth << '\n';
+            assert(0);
+        }
+    }
+}
+
+/**
+ * A key sharing the slot of a stored one is not found, the last store
+ * wins, and no probe ever returns the data of the other key, even while
+ * two threads write the slot: the check of one store never matches the
+ * data of the other.
+ */
+static void testTranspositionTableCollisions(void) {
+    TranspositionTable table(1);
+    TTEntry entry;
+
+    table.store(KEY_A, -25, 0x31c, 4, BOUND_LOWER);
+    bool found = table.probe(KEY_B, &entry);
+    assert(!found);
+    table.store(KEY_B, 25, 0x195, 6, BOUND_UPPER);
+    found = table.probe(KEY_A, &entry);
+    assert(!found);
+    found = table.probe(KEY_B, &entry);
+    assert(found && entry.score == 25 && entry.move == 0x195);
+
+    const TTEntry a = {-25, 0x31c, 4, BOUND_LOWER};
+    const TTEntry b = {25, 0x195, 6, BOUND_UPPER};
+    const int stores = 200000;
+
+    std::thread writerA([&table, &a, stores]() {
+        for (int i = 0; i < stores; i++) {
+            table.store(KEY_A, a.score, a.move, a.depth, a.bound);
+        }
+    });
+    std::thread writerB([&table, &b, stores]() {
+        for (int i = 0; i < stores; i++) {
+            table.store(KEY_B, b.score, b.move, b.depth, b.bound);
+        }
+    });
+
+    int mismatches = 0;
+    for (int i = 0; i < stores; i++) {
+        if (table.probe(KEY_A, &entry) && !sameEntry(entry, a)) {
+            mismatches++;
+        }
+        if (table.probe(KEY_B, &entry) && !sameEntry(entry, b)) {
+            mismatches++;
+        }
+    }
+    writerA.join();
+    writerB.join();
+
+    if (mismatches) {
+        std::cerr << "Test failed\n" << mismatches << " torn entries\n";
+        assert(0);
+    }
+}
+
+// Nothing stored before a resize or a clear is found afterwards
+static void testTranspositionTableClear(void) {
+    const int keys = 4096;
+    TranspositionTable table(1);
+    TTEntry entry;
+
+    auto fill = [&table, keys]() {
+        for (int i = 0; i < keys; i++) {
+            table.store(KEY_A * (i + 1), i, 0x31c, 5, BOUND_EXACT);
+        }
+    };
+    auto found = [&table, &entry, keys]() {
+        int count = 0;
+        for (int i = 0; i < keys; i++) {
+            count += table.probe(KEY_A * (i + 1), &entry);
+        }
+        return count;
+    };
+
+    fill();
+    assert(found() > 0);
+    table.clear(4);
+    assert(found() == 0);
+
+    // Same size, the table is only cleared
+    fill();
+    table.resize(1, 1);
+    assert(table.sizeMB() == 1);
+    assert(found() == 0);
+
+    fill();
+    table.resize(2, 3);
+    assert(table.sizeMB() == 2);
+    assert(found() == 0);
+
+    fill();
+    assert(found() > 0);
+    table.resize(1, 2);
+    assert(table.sizeMB() == 1);
+    assert(found() == 0);
+}
+
+void testTranspositionTable(void) {
+    std::cout << "testTranspositionTableRoundTrip()\n";
+    std::cout.flush();
+    testTranspositionTableRoundTrip();
+    std::cout << "DONE\n";
+
+    std::cout << "testTranspositionTableCollisions()\n";
+    std::cout.flush();
+    testTranspositionTableCollisions();
+    std::cout << "DONE\n";
+
+    std::cout << "testTranspositionTableClear()\n";
+    std::cout.flush();
+    testTranspositionTableClear();
+    std::cout << "DONE\n";
+}
@@ -0,0 +1,97 @@
+/* Copyright 2021 DucaPowr Team */
+#include "testUci.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/engine.h"
+#include "../src/uciHandler.h"
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+/**
+ * Plays the moves of a "position" command on a fresh board, counting the
+ * checks as Engine::userMove does.
+ */
+static std::string replay(Board& board, const std::string& fen,
+        const std::vector<std::string>& moves) {
+    Generator generator(board);
+    MoveChecker checker(board);
+
+    loadFen(board, fen.c_str());
+    for (const std::string& move : moves) {
+        board.applyMove(board.convertSanToMove(move));
+        if (checker.isCheck(
+                generator.getAttackBB(otherSide(board.sideToMove)))) {
+            board.updateCheckCounter(1, board.sideToMove);
+        }
+    }
+    return board.toFEN();
+}
+
+// "position" keeps the moves it shares with the last one, takes back the
+// others and plays the new ones, the check counters included
+static void testUciSetPosition(Board& board) {
+    static const char *kiwipete =
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - "
+        "0 1 +1+2";
+    struct Step {
+        std::string fen;
+        std::vector<std::string> moves;
+    };
+    const std::vector<Step> steps = {
+        {START_FEN, {"e2e4", "e7e5", "g1f3"}},
+        // Same prefix, two more moves
+        {START_FEN, {"e2e4", "e7e5", "g1f3", "b8c6", "f1b5"}},
+        // Diverges after two moves, with checks on the new line
+        {START_FEN, {"e2e4", "e7e5", "f1c4", "b8c6", "c4f7", "e8f7",
+            "d1h5", "g7g6"}},
+        // Shorter: the check given by the last moves is taken back
+        {START_FEN, {"e2e4", "e7e5", "f1c4", "b8c6", "c4f7"}},
+        {START_FEN, {"e2e4", "e7e5", "f1c4"}},
+        // Another starting position, with checks already given
+        {kiwipete, {}},
+        {kiwipete, {"e1g1", "a8b8", "e5f7"}},
+        {kiwipete, {"e1g1"}},
+        {START_FEN, {}},
+        {START_FEN, {"d2d4"}},
+    };
+
+    Engine engine;
+    std::ostringstream out;
+    UciHandler handler(engine, out);
+
+    for (const Step& step : steps) {
+        std::string command = "position " +
+            (step.fen == START_FEN ? "startpos" : "fen " + step.fen);
+        if (!step.moves.empty()) {
+            command += " moves";
+            for (const std::string& move : step.moves) {
+                command += " " + move;
+            }
+        }
+        handler.handle(command);
+
+        std::string expected = replay(board, step.fen, step.moves);
+        if (engine.toFEN() != expected) {
+            std::cerr << "Test failed\n" << "command=" << command <<
+                "\nengine=" << engine.toFEN() << "\nexpected=" << expected <<
+                '\n';
+            assert(0);
+        }
+    }
+
+    // No position was rejected
+    assert(out.str().empty());
+}
+
+void testUci(void) {
+    Board board;
+    board.init();
+
+    std::cout << "testUciSetPosition()\n";
+    std::cout.flush();
+    testUciSetPosition(board);
+    std::cout << "DONE\n";
+}
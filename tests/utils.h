@@ -2,3 +2,18 @@
 #pragma once
 
 #include <cassert>
+#include <iostream>
+
+#include "../src/board.h"
+
+/**
+ * Loads a position the test needs. The call is kept out of assert(), which
+ * compiles to nothing with NDEBUG.
+ */
+static inline void loadFen(Board& board, const char *fen) {
+    bool valid = board.setFromFEN(fen);
+    if (!valid) {
+        std::cerr << "Test failed\n" << "invalid fen=" << fen << '\n';
+        assert(0);
+    }
+}
@@ -0,0 +1,484 @@
+/* Copyright 2021 DucaPowr Team */
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/board.h"
+#include "../src/book.h"
+#include "../src/moveChecker.h"
+#include "../src/moveGen.h"
+#include "../src/perft.h"
+#include "../src/san.h"
+
+#define DEBUG_FILE_NAME "bookgen.debug"
+
+std::ofstream Logger::debugFile(DEBUG_FILE_NAME);
+
+struct BookgenOptions {
+    std::vector<std::string> pgnFiles;
+    std::string bookFile = "book.bin";
+    // Moves after this ply are not counted
+    int maxPlies = 20;
+    // Moves played in fewer games are left out of the book
+    unsigned int minGames = 1;
+    // Memory for the counters, before the rarest moves are dropped
+    size_t maxMB = 1024;
+};
+
+/**
+ * One game of a PGN file. Only the moves of the game being read are kept,
+ * so files of any size are read in constant memory.
+ */
+struct PgnGame {
+    // FEN tag, empty for the initial position
+    std::string fen;
+    std::string variant;
+    // 1-0, 0-1, 1/2-1/2 or * (unknown)
+    std::string result;
+    // SAN or coordinate notation, without move numbers
+    std::vector<std::string> moves;
+
+    void clear(void) {
+        fen.clear();
+        variant.clear();
+        result = "*";
+        moves.clear();
+    }
+};
+
+/**
+ * Streams the games of a PGN file. Comments ({} and ;), variations and
+ * numeric annotations are skipped, and a game ends at its result or at the
+ * tags of the next game.
+ */
+class PgnReader {
+ public:
+    explicit PgnReader(std::istream& in) : in(in) {
+    }
+
+    // Returns false at the end of the file
+    bool next(PgnGame *game) {
+        game->clear();
+        bool started = false;
+
+        while (havePending || std::getline(in, line)) {
+            havePending = false;
+
+            if (commentDepth == 0 && variationDepth == 0 &&
+                    !line.empty() && line[0] == '[') {
+                // Tags after the moves start the next game
+                if (!game->moves.empty()) {
+                    havePending = true;
+                    return true;
+                }
+                readTag(line, game);
+                started = true;
+                continue;
+            }
+
+            if (readMoves(line, game)) {
+                return true;
+            }
+            started = started || !game->moves.empty();
+        }
+
+        return started;
+    }
+
+ private:
+    std::istream& in;
+    std::string line;
+    // The line that ended the last game belongs to the next one
+    bool havePending = false;
+    int commentDepth = 0;
+    int variationDepth = 0;
+
+    static void readTag(const std::string& tag, PgnGame *game) {
+        size_t nameEnd = tag.find(' ');
+        size_t valueStart = tag.find('"');
+        size_t valueEnd = tag.rfind('"');
+        if (nameEnd == std::string::npos || valueStart == valueEnd) {
+            return;
+        }
+
+        std::string name = tag.substr(1, nameEnd - 1);
+        std::string value = tag.substr(valueStart + 1,
+            valueEnd - valueStart - 1);
+        if (name == "FEN") {
+            game->fen = value;
+        } else if (name == "Variant") {
+            game->variant = value;
+        } else if (name == "Result") {
+            game->result = value;
+        }
+    }
+
+    static bool isResult(const std::string& token) {
+        return token == "1-0" || token == "0-1" || token == "1/2-1/2" ||
+            token == "*";
+    }
+
+    // Returns true once the result token of the game is read
+    bool readMoves(const std::string& text, PgnGame *game) {
+        std::string token;
+        for (size_t i = 0; i <= text.size(); i++) {
+            char c = i < text.size() ? text[i] : ' ';
+
+            if (commentDepth > 0) {
+                commentDepth -= c == '}';
+                continue;
+            }
+            if (c == '{' || c == ';' || c == '(' || c == ')' ||
+                    isspace(static_cast<unsigned char>(c))) {
+                if (!token.empty() && addToken(token, game)) {
+                    return true;
+                }
+                token.clear();
+
+                if (c == ';') {
+                    break;
+                }
+                commentDepth += c == '{';
+                variationDepth += (c == '(') - (c == ')');
+                continue;
+            }
+            token += c;
+        }
+        return false;
+    }
+
+    bool addToken(std::string token, PgnGame *game) {
+        if (isResult(token)) {
+            game->result = token;
+            return variationDepth == 0;
+        }
+        if (variationDepth > 0 || token[0] == '$') {
+            return false;
+        }
+
+        // Move numbers, also when glued to the move (1.e4, 12...Nf6)
+        size_t digits = 0;
+        while (digits < token.size() &&
+                isdigit(static_cast<unsigned char>(token[digits]))) {
+            digits++;
+        }
+        if (digits == token.size()) {
+            return false;
+        }
+        if (token[digits] == '.') {
+            size_t start = token.find_first_not_of('.', digits);
+            token.erase(0, start == std::string::npos ? token.size() : start);
+        }
+
+        if (!token.empty() && token[0] != '.') {
+            game->moves.push_back(token);
+        }
+        return false;
+    }
+};
+
+/**
+ * (position key, Polyglot move) -> results, in one open addressing table.
+ * An entry takes 16 bytes; when the table would outgrow the memory limit,
+ * the moves seen in a single game are dropped instead.
+ */
+class BookCounts {
+ public:
+    struct Entry {
+        U64 key;
+        // 0 marks an empty slot, no move goes from a1 to a1
+        uint16_t move;
+        // Games in which the side that played the move won, drew, lost
+        uint16_t wins;
+        uint16_t draws;
+        uint16_t losses;
+    };
+
+    explicit BookCounts(size_t maxMB) : maxEntries((maxMB << 20) /
+            sizeof(Entry)) {
+        resize(1 << 16);
+    }
+
+    void add(U64 key, uint16_t move, double score) {
+        if (2 * (used + 1) > entries.size() && !grow()) {
+            prune();
+        }
+
+        Entry& e = slot(key, move);
+        if (e.move == 0) {
+            e.key = key;
+            e.move = move;
+            used++;
+        }
+
+        // The counters saturate instead of wrapping
+        uint16_t& counter = score == 1 ? e.wins :
+            score == 0 ? e.losses : e.draws;
+        counter += counter < UINT16_MAX;
+    }
+
+    /**
+     * Packs the used entries at the start of the table and sorts them by
+     * key, without a second copy of the table. No more moves can be added
+     * afterwards.
+     */
+    const std::vector<Entry>& sorted(void) {
+        auto end = std::remove_if(entries.begin(), entries.end(),
+            [](const Entry& e) { return e.move == 0; });
+        entries.erase(end, entries.end());
+
+        std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) {
+                return a.key < b.key || (a.key == b.key && a.move < b.move);
+            });
+        return entries;
+    }
+
+    size_t size(void) {
+        return used;
+    }
+
+    size_t pruned = 0;
+    // Moves counted after a check, whose keys are not Polyglot ones
+    size_t afterCheck = 0;
+
+ private:
+    std::vector<Entry> entries;
+    size_t used = 0;
+    size_t maxEntries;
+
+    Entry& slot(U64 key, uint16_t move) {
+        size_t mask = entries.size() - 1;
+        size_t i = (key ^ (move * 0x9E3779B97F4A7C15ULL)) & mask;
+        while (entries[i].move != 0 &&
+                (entries[i].key != key || entries[i].move != move)) {
+            i = (i + 1) & mask;
+        }
+        return entries[i];
+    }
+
+    void resize(size_t count) {
+        std::vector<Entry> old;
+        old.swap(entries);
+        entries.assign(count, Entry());
+        used = 0;
+
+        for (const Entry& e : old) {
+            if (e.move != 0 && e.wins + e.draws + e.losses > 0) {
+                slot(e.key, e.move) = e;
+                used++;
+            }
+        }
+    }
+
+    bool grow(void) {
+        if (entries.size() * 2 > maxEntries) {
+            return false;
+        }
+        resize(entries.size() * 2);
+        return true;
+    }
+
+    // Drops the moves seen in a single game
+    void prune(void) {
+        size_t before = used;
+        for (Entry& e : entries) {
+            if (e.move != 0 && e.wins + e.draws + e.losses <= 1) {
+                e.wins = e.draws = e.losses = 0;
+            }
+        }
+        resize(entries.size());
+        pruned += before - used;
+
+        DIE(2 * (used + 1) > entries.size(),
+            "bookgen: the counters do not fit in -mb megabytes");
+    }
+};
+
+// Finds a legal move from its xboard coordinate notation
+static uint16_t findMove(Board& board, Perft& perft, const std::string& s) {
+    uint16_t moves[MAX_MOVES_AT_STEP];
+    uint16_t movesLen = 0;
+    perft.legalMoves(moves, &movesLen);
+
+    for (int i = 0; i < movesLen; i++) {
+        if (board.convertMoveToSan(moves[i]) == s) {
+            return moves[i];
+        }
+    }
+    return 0xffff;
+}
+
+/**
+ * Replays a game and counts its first moves.
+ * @return Returns false if a move is not legal, the moves before it are
+ * counted anyway.
+ */
+static bool addGame(const PgnGame& game, int maxPlies, BookCounts *counts) {
+    // Built once, the move generator tables take a while
+    static Board board;
+    static Generator generator(board);
+    static MoveChecker checker(board);
+    static Perft perft(board, generator, checker);
+
+    board.init();
+    if (!game.fen.empty() && !board.setFromFEN(game.fen)) {
+        return false;
+    }
+
+    // 1 for a white win, 0.5 for a draw
+    double whiteScore = game.result == "1-0" ? 1 :
+        game.result == "0-1" ? 0 : 0.5;
+
+    for (int ply = 0; ply < maxPlies && ply < (int) game.moves.size();
+            ply++) {
+        const std::string& token = game.moves[ply];
+        uint16_t move = parseSan(board, generator, checker, token);
+        if (move == 0xffff) {
+            move = findMove(board, perft, token);
+        }
+        if (move == 0xffff) {
+            return false;
+        }
+
+        double score = board.sideToMove == whiteSide ?
+            whiteScore : 1 - whiteScore;
+        counts->add(Book::key(board), Book::toPolyglotMove(move), score);
+
+        CompactPosition pos;
+        board.getPosition(&pos);
+        counts->afterCheck += pos.checkCount[0] + pos.checkCount[1] > 0;
+
+        board.applyMove(move);
+        if (checker.isCheck(
+                generator.getAttackBB(otherSide(board.sideToMove)))) {
+            board.updateCheckCounter(1, board.sideToMove);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Writes the book entries: the weight of a move is 2 * wins + draws,
+ * scaled down to 16 bits if needed. Moves that never scored are left out.
+ */
+static size_t writeBook(const std::string& fileName,
+        const std::vector<BookCounts::Entry>& counts, unsigned int minGames) {
+    uint32_t maxWeight = 0;
+    for (const BookCounts::Entry& e : counts) {
+        maxWeight = std::max<uint32_t>(maxWeight, 2 * e.wins + e.draws);
+    }
+    double scale = maxWeight > UINT16_MAX ?
+        static_cast<double>(UINT16_MAX) / maxWeight : 1;
+
+    std::ofstream out(fileName, std::ios::binary);
+    DIE(!out, "Cannot open the book file");
+
+    size_t written = 0;
+    for (const BookCounts::Entry& e : counts) {
+        uint32_t weight = 2 * e.wins + e.draws;
+        if (weight == 0 ||
+                static_cast<unsigned int>(e.wins + e.draws + e.losses) <
+                minGames) {
+            continue;
+        }
+        weight = std::max<uint32_t>(weight * scale, 1);
+
+        uint8_t entry[BOOK_ENTRY_SIZE] = {0};
+        for (int i = 0; i < 8; i++) {
+            entry[i] = e.key >> (56 - 8 * i);
+        }
+        entry[8] = e.move >> 8;
+        entry[9] = e.move;
+        entry[10] = weight >> 8;
+        entry[11] = weight;
+        out.write(reinterpret_cast<char *>(entry), BOOK_ENTRY_SIZE);
+        written++;
+    }
+
+    DIE(!out, "Cannot write the book file");
+    return written;
+}
+
+static bool isThreeCheck(const std::string& variant) {
+    return variant.empty() || variant == "3check" ||
+        variant == "threecheck" || variant == "3-check";
+}
+
+/**
+ * Usage: bookgen [-o book.bin] [-plies N] [-mingames N] [-mb N] <pgn> ...
+ * Builds an opening book for the engine (see src/book.h) from PGN games.
+ */
+int main(int argc, char **argv) {
+    BookgenOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "-o" && hasValue) {
+            options.bookFile = argv[++i];
+        } else if (arg == "-plies" && hasValue) {
+            options.maxPlies = atoi(argv[++i]);
+        } else if (arg == "-mingames" && hasValue) {
+            options.minGames = atoi(argv[++i]);
+        } else if (arg == "-mb" && hasValue) {
+            options.maxMB = atoi(argv[++i]);
+        } else if (arg[0] != '-') {
+            options.pgnFiles.push_back(arg);
+        } else {
+            options.pgnFiles.clear();
+            break;
+        }
+    }
+
+    if (options.pgnFiles.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [-o book.bin] [-plies N] "
+            "[-mingames N] [-mb N] <pgn> ...\n";
+        return 1;
+    }
+
+    BookCounts counts(options.maxMB);
+    size_t games = 0, used = 0, skipped = 0, illegal = 0;
+
+    for (const std::string& fileName : options.pgnFiles) {
+        std::ifstream in(fileName);
+        DIE(!in, "Cannot open the PGN file");
+
+        PgnReader reader(in);
+        PgnGame game;
+        while (reader.next(&game)) {
+            games++;
+            // Games without a result or of another variant say nothing
+            // about 3-check openings
+            if (game.result == "*" || !isThreeCheck(game.variant)) {
+                skipped++;
+                continue;
+            }
+
+            illegal += !addGame(game, options.maxPlies, &counts);
+            used++;
+        }
+    }
+
+    size_t written = writeBook(options.bookFile, counts.sorted(),
+        options.minGames);
+
+    std::cout << "Games: " << games << " (" << used << " used, " <<
+        skipped << " skipped, " << illegal << " with an illegal move)\n";
+    std::cout << "Moves counted: " << counts.size() << " (" <<
+        counts.pruned << " rare moves dropped)\n";
+    std::cout << "Moves played after a check: " << counts.afterCheck <<
+        " (the other positions keep their standard Polyglot keys)\n";
+    std::cout << "Book entries: " << written << " written to " <<
+        options.bookFile << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+/* Copyright 2021 DucaPowr Team */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../src/batchEval.h"
+#include "../src/board.h"
+#include "../src/moveGen.h"
+
+#define DEBUG_FILE_NAME "evalBench.debug"
+
+std::ofstream Logger::debugFile(DEBUG_FILE_NAME);
+
+/**
+ * Plays random games from the initial position and stores every position
+ * reached. The seed is fixed, so every run scores the same positions.
+ */
+static std::vector<CompactPosition> randomPositions(size_t count) {
+    std::vector<CompactPosition> positions;
+    Board board;
+    Generator generator(board);
+    std::mt19937 rng(20211);
+
+    while (positions.size() < count) {
+        board.init();
+
+        for (int ply = 0; ply < 100 && positions.size() < count; ply++) {
+            uint16_t moves[MAX_MOVES_AT_STEP];
+            uint16_t movesLen = 0;
+            generator.generateMoves(moves, &movesLen);
+
+            if (movesLen == 0) {
+                break;
+            }
+
+            board.applyMove(moves[rng() % movesLen]);
+
+            // Stop the game once a king is captured
+            if (!board.getKingBB(whiteSide) || !board.getKingBB(blackSide)) {
+                break;
+            }
+
+            CompactPosition pos;
+            board.getPosition(&pos);
+            positions.push_back(pos);
+        }
+    }
+
+    return positions;
+}
+
+/**
+ * Usage: ./evalBench [positions] [max threads]
+ * Prints the eval throughput of evalBatch() for 1, 2, 4, ... threads.
+ */
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? atol(argv[1]) : 1000000;
+    unsigned int maxThreads = argc > 2 ? atoi(argv[2]) :
+        std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<CompactPosition> positions = randomPositions(count);
+    std::vector<int> scores(count);
+
+    for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+        auto start = std::chrono::steady_clock::now();
+        evalBatch(positions.data(), count, scores.data(), threads);
+        auto end = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        long long checksum = 0;
+        for (int score : scores) {
+            checksum += score;
+        }
+
+        std::cout << "threads " << threads << " positions " << count <<
+            " time " << seconds << " s " <<
+            static_cast<long long>(count / seconds) << " positions/s" <<
+            " checksum " << checksum << '\n';
+    }
+
+    return 0;
+}
@@ -0,0 +1,611 @@
+/* Copyright 2021 DucaPowr Team */
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/board.h"
+#include "../src/moveChecker.h"
+#include "../src/moveGen.h"
+#include "../src/perft.h"
+#include "../src/san.h"
+#include "../src/threadPool.h"
+
+#define DEBUG_FILE_NAME "match.debug"
+
+std::ofstream Logger::debugFile(DEBUG_FILE_NAME);
+
+// Opening lines, in xboard coordinate notation. Every one is played twice,
+// with the colours swapped.
+static const char *defaultOpenings[] = {
+    "e2e4 e7e5",
+    "e2e4 c7c5",
+    "e2e4 e7e6",
+    "e2e4 c7c6",
+    "e2e4 d7d5",
+    "d2d4 d7d5",
+    "d2d4 g8f6 c2c4 e7e6",
+    "d2d4 g8f6 c2c4 g7g6",
+    "c2c4 e7e5",
+    "g1f3 d7d5",
+    "b1c3 d7d5",
+    "g2g3 e7e5",
+};
+
+struct MatchOptions {
+    std::string engines[2];
+    int games = 100;
+    unsigned int concurrency = 0;
+    // Sent as "sd <depth>" when positive
+    int depth = 0;
+    // Seconds per move, sent as "st <seconds>" when positive
+    std::string moveTime;
+    // Seconds an engine may take for one move
+    int timeout = 60;
+    // Games longer than this are adjudicated as draws
+    int maxPlies = 300;
+    std::string pgnFile = "match.pgn";
+    std::vector<std::string> openings;
+    // SPRT hypotheses (Elo of engine A over engine B) and error rates
+    double elo0 = 0, elo1 = 5, alpha = 0.05, beta = 0.05;
+};
+
+/**
+ * An engine process, talking xboard over a pair of pipes.
+ */
+class EngineProcess {
+ public:
+    /**
+     * Starts the engine in the directory of its binary, so that it finds
+     * its data files.
+     * @return Returns false if the process could not be started.
+     */
+    bool start(const std::string& path) {
+        int toEngine[2], fromEngine[2];
+        if (pipe2(toEngine, O_CLOEXEC) || pipe2(fromEngine, O_CLOEXEC)) {
+            return false;
+        }
+
+        size_t slash = path.rfind('/');
+        std::string dir = slash == std::string::npos ? "." :
+            path.substr(0, slash + 1);
+        std::string binary = slash == std::string::npos ? "./" + path :
+            path.substr(slash + 1);
+        if (slash != std::string::npos) {
+            binary = "./" + binary;
+        }
+
+        pid = fork();
+        if (pid < 0) {
+            return false;
+        }
+
+        if (pid == 0) {
+            // Only async-signal-safe calls until exec
+            dup2(toEngine[0], STDIN_FILENO);
+            dup2(fromEngine[1], STDOUT_FILENO);
+            if (chdir(dir.c_str()) == 0) {
+                execl(binary.c_str(), binary.c_str(), (char *) NULL);
+            }
+            _exit(127);
+        }
+
+        close(toEngine[0]);
+        close(fromEngine[1]);
+        in = toEngine[1];
+        out = fromEngine[0];
+
+        return true;
+    }
+
+    void send(const std::string& line) {
+        std::string data = line + '\n';
+        if (write(in, data.c_str(), data.size()) < 0) {
+            // The engine is gone, the next read fails
+        }
+    }
+
+    /**
+     * Reads one line of the engine output.
+     * @return Returns false on timeout or if the engine exited.
+     */
+    bool readLine(std::string *line, int timeoutSeconds) {
+        auto deadline = std::chrono::steady_clock::now() +
+            std::chrono::seconds(timeoutSeconds);
+
+        while (true) {
+            size_t newline = buffer.find('\n');
+            if (newline != std::string::npos) {
+                *line = buffer.substr(0, newline);
+                buffer.erase(0, newline + 1);
+                return true;
+            }
+
+            int left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            struct pollfd pfd = {out, POLLIN, 0};
+            if (left <= 0 || poll(&pfd, 1, left) <= 0) {
+                return false;
+            }
+
+            char chunk[4096];
+            ssize_t n = read(out, chunk, sizeof(chunk));
+            if (n <= 0) {
+                return false;
+            }
+            buffer.append(chunk, n);
+        }
+    }
+
+    // Asks the engine to quit, and kills it if it does not
+    void stop(void) {
+        if (pid <= 0) {
+            return;
+        }
+
+        send("quit");
+        close(in);
+
+        for (int i = 0; i < 20; i++) {
+            if (waitpid(pid, NULL, WNOHANG) == pid) {
+                close(out);
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        close(out);
+    }
+
+    ~EngineProcess() {
+        stop();
+        pid = -1;
+    }
+
+    // Whether the engine plays its side on its own (after "go")
+    bool playing = false;
+
+ private:
+    pid_t pid = -1;
+    int in = -1, out = -1;
+    std::string buffer;
+};
+
+struct GameResult {
+    // 1 if white won, 0.5 for a draw, 0 if black won
+    double score;
+    std::string result;
+    std::string reason;
+    std::vector<std::string> sanMoves;
+};
+
+/**
+ * Waits for the move of an engine.
+ * @return the move, or "" if the engine resigned, stopped or timed out
+ */
+static std::string readMove(EngineProcess& engine, int timeout,
+        std::string *reason) {
+    std::string line;
+    while (engine.readLine(&line, timeout)) {
+        if (line.compare(0, 5, "move ") == 0) {
+            return line.substr(5);
+        }
+        if (line.compare(0, 3, "1-0") == 0 || line.compare(0, 3, "0-1") == 0 ||
+                line.compare(0, 7, "1/2-1/2") == 0 ||
+                line.compare(0, 6, "resign") == 0) {
+            *reason = "resigns";
+            return "";
+        }
+    }
+
+    *reason = "timeout or crash";
+    return "";
+}
+
+// Finds a legal move from its xboard coordinate notation
+static uint16_t findMove(Board& board, Perft& perft, const std::string& s) {
+    uint16_t moves[MAX_MOVES_AT_STEP];
+    uint16_t movesLen = 0;
+    perft.legalMoves(moves, &movesLen);
+
+    for (int i = 0; i < movesLen; i++) {
+        if (board.convertMoveToSan(moves[i]) == s) {
+            return moves[i];
+        }
+    }
+    return 0xffff;
+}
+
+// Plays a move on the referee board and counts the check it gives
+static void playMove(Board& board, Generator& generator,
+        MoveChecker& checker, uint16_t move) {
+    board.applyMove(move);
+    if (checker.isCheck(generator.getAttackBB(otherSide(board.sideToMove)))) {
+        board.updateCheckCounter(1, board.sideToMove);
+    }
+}
+
+/**
+ * Plays one game. The runner keeps its own board to check the moves and to
+ * adjudicate the end of the game.
+ */
+static GameResult playGame(const MatchOptions& options,
+        const std::string& white, const std::string& black,
+        const std::string& opening) {
+    GameResult game;
+    Board board;
+    board.init();
+    Generator generator(board);
+    MoveChecker checker(board);
+    Perft perft(board, generator, checker);
+
+    EngineProcess engines[2];
+    const std::string *paths[2] = {&white, &black};
+    for (int side = whiteSide; side <= blackSide; side++) {
+        EngineProcess& e = engines[side];
+        std::string line;
+
+        if (!e.start(*paths[side])) {
+            game.reason = "cannot start " + *paths[side];
+            game.score = side == whiteSide ? 0 : 1;
+            game.result = side == whiteSide ? "0-1" : "1-0";
+            return game;
+        }
+
+        e.send("xboard");
+        e.send("protover 2");
+        while (e.readLine(&line, options.timeout) &&
+                line.find("done=1") == std::string::npos) {
+        }
+
+        e.send("new");
+        if (options.depth > 0) {
+            e.send("sd " + std::to_string(options.depth));
+        }
+        if (!options.moveTime.empty()) {
+            e.send("st " + options.moveTime);
+        }
+        e.send("force");
+    }
+
+    auto finish = [&game](double score, const std::string& reason) {
+        game.score = score;
+        game.result = score == 1 ? "1-0" : score == 0 ? "0-1" : "1/2-1/2";
+        game.reason = reason;
+        return game;
+    };
+
+    std::istringstream openingMoves(opening);
+    std::string moveString;
+    while (openingMoves >> moveString) {
+        uint16_t move = findMove(board, perft, moveString);
+        DIE(move == 0xffff, "Illegal opening move");
+
+        game.sanMoves.push_back(moveToSan(board, generator, checker, move));
+        playMove(board, generator, checker, move);
+        engines[whiteSide].send("usermove " + moveString);
+        engines[blackSide].send("usermove " + moveString);
+    }
+
+    for (int ply = game.sanMoves.size(); ; ply++) {
+        Side side = board.sideToMove;
+        double sideWins = side == whiteSide ? 1 : 0;
+
+        CompactPosition pos;
+        board.getPosition(&pos);
+        // The side to move has received its third check
+        if (pos.checkCount[side] >= 3) {
+            return finish(1 - sideWins, "three checks");
+        }
+
+        uint16_t moves[MAX_MOVES_AT_STEP];
+        uint16_t movesLen = 0;
+        perft.legalMoves(moves, &movesLen);
+        if (movesLen == 0) {
+            bool inCheck = checker.isCheck(
+                generator.getAttackBB(otherSide(side)));
+            return inCheck ? finish(1 - sideWins, "checkmate") :
+                finish(0.5, "stalemate");
+        }
+
+        if (ply >= options.maxPlies) {
+            return finish(0.5, "move limit");
+        }
+
+        EngineProcess& engine = engines[side];
+        if (!engine.playing) {
+            engine.send("go");
+            engine.playing = true;
+        }
+
+        std::string reason;
+        moveString = readMove(engine, options.timeout, &reason);
+        uint16_t move = moveString.empty() ? 0xffff :
+            findMove(board, perft, moveString);
+        if (move == 0xffff) {
+            if (reason.empty()) {
+                reason = "illegal move " + moveString;
+            }
+            std::string name = side == whiteSide ? "White" : "Black";
+            return finish(1 - sideWins, name + " " + reason);
+        }
+
+        game.sanMoves.push_back(moveToSan(board, generator, checker, move));
+        playMove(board, generator, checker, move);
+
+        // The opponent replies on its own once it has been told to "go"
+        engines[otherSide(side)].send("usermove " + moveString);
+    }
+}
+
+static std::string engineName(const std::string& path, int index) {
+    size_t slash = path.rfind('/');
+    std::string name = slash == std::string::npos ? path :
+        path.substr(slash + 1);
+    return name + (index == 0 ? " A" : " B");
+}
+
+static void writePgn(std::ofstream& pgn, int round, const std::string& white,
+        const std::string& black, const GameResult& game) {
+    char date[16];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y.%m.%d", localtime(&now));
+
+    pgn << "[Event \"duca match\"]\n";
+    pgn << "[Site \"local\"]\n";
+    pgn << "[Date \"" << date << "\"]\n";
+    pgn << "[Round \"" << round << "\"]\n";
+    pgn << "[White \"" << white << "\"]\n";
+    pgn << "[Black \"" << black << "\"]\n";
+    pgn << "[Result \"" << game.result << "\"]\n";
+    pgn << "[Variant \"Three-check\"]\n";
+    pgn << "[Termination \"" << game.reason << "\"]\n\n";
+
+    std::string line;
+    for (size_t i = 0; i < game.sanMoves.size(); i++) {
+        std::string token;
+        if (i % 2 == 0) {
+            token = std::to_string(i / 2 + 1) + ". ";
+        }
+        token += game.sanMoves[i] + ' ';
+
+        if (line.size() + token.size() > 80) {
+            pgn << line << '\n';
+            line.clear();
+        }
+        line += token;
+    }
+    pgn << line << game.result << "\n\n";
+    pgn.flush();
+}
+
+/**
+ * Score statistics of engine A, from its wins, draws and losses.
+ */
+struct MatchStats {
+    int wins = 0, draws = 0, losses = 0;
+
+    int games(void) const {
+        return wins + draws + losses;
+    }
+
+    double score(void) const {
+        return (wins + 0.5 * draws) / games();
+    }
+
+    // Variance of the result of one game
+    double variance(void) const {
+        double s = score();
+        return (wins * (1 - s) * (1 - s) + draws * (0.5 - s) * (0.5 - s) +
+            losses * s * s) / games();
+    }
+
+    static double elo(double score) {
+        score = std::min(std::max(score, 1e-6), 1 - 1e-6);
+        // + 0.0 turns -0 into 0 for even scores
+        return -400 * log10(1 / score - 1) + 0.0;
+    }
+
+    static double expectedScore(double elo) {
+        return 1 / (1 + pow(10, -elo / 400));
+    }
+
+    /**
+     * Log likelihood ratio of H1 (elo1) against H0 (elo0), with the normal
+     * approximation of the generalized SPRT.
+     */
+    double llr(double elo0, double elo1) const {
+        double var = variance();
+        if (games() == 0 || var <= 0) {
+            return 0;
+        }
+        double s0 = expectedScore(elo0), s1 = expectedScore(elo1);
+        return games() * (s1 - s0) * (2 * score() - s0 - s1) / (2 * var);
+    }
+};
+
+static void printSummary(const MatchOptions& options, const MatchStats& stats,
+        std::ostream& out) {
+    if (stats.games() == 0) {
+        return;
+    }
+
+    double s = stats.score();
+    // 95% confidence interval
+    double margin = 1.96 * sqrt(stats.variance() / stats.games());
+
+    out << std::fixed << std::setprecision(2);
+    out << "Score of A vs B: " << stats.wins << " - " << stats.losses <<
+        " - " << stats.draws << " [" << s << "] " << stats.games() <<
+        " games\n";
+    out << "Elo difference: " << MatchStats::elo(s) << " [" <<
+        MatchStats::elo(s - margin) << ", " << MatchStats::elo(s + margin) <<
+        "]\n";
+
+    double llr = stats.llr(options.elo0, options.elo1);
+    double lower = log(options.beta / (1 - options.alpha));
+    double upper = log((1 - options.beta) / options.alpha);
+    out << "SPRT elo0=" << options.elo0 << " elo1=" << options.elo1 <<
+        ": LLR " << llr << " [" << lower << ", " << upper << "] " <<
+        (llr >= upper ? "H1 accepted" : llr <= lower ? "H0 accepted" :
+        "no decision") << std::endl;
+}
+
+static void loadOpenings(const std::string& fileName,
+        std::vector<std::string> *openings) {
+    std::ifstream f(fileName);
+    DIE(!f, "Cannot open the openings file");
+
+    std::string line;
+    while (std::getline(f, line)) {
+        if (!line.empty()) {
+            openings->push_back(line);
+        }
+    }
+}
+
+/**
+ * Usage: ./match [options] <engine A> <engine B>
+ *   -games N        games to play (100)
+ *   -concurrency N  games played at once (all hardware threads)
+ *   -depth N        search depth, sent as "sd N"
+ *   -st N           seconds per move, sent as "st N"
+ *   -timeout N      seconds an engine may think on one move (60)
+ *   -maxplies N     adjudicate longer games as draws (300)
+ *   -pgn FILE       where to write the games (match.pgn)
+ *   -openings FILE  one opening per line, in coordinate notation
+ *   -elo0 E -elo1 E -alpha A -beta B
+ *                   SPRT bounds (0, 5, 0.05, 0.05). The match stops early
+ *                   once a hypothesis is accepted.
+ */
+int main(int argc, char **argv) {
+    MatchOptions options;
+    int engineCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "-games" && hasValue) {
+            options.games = atoi(argv[++i]);
+        } else if (arg == "-concurrency" && hasValue) {
+            options.concurrency = atoi(argv[++i]);
+        } else if (arg == "-depth" && hasValue) {
+            options.depth = atoi(argv[++i]);
+        } else if (arg == "-st" && hasValue) {
+            options.moveTime = argv[++i];
+        } else if (arg == "-timeout" && hasValue) {
+            options.timeout = atoi(argv[++i]);
+        } else if (arg == "-maxplies" && hasValue) {
+            options.maxPlies = atoi(argv[++i]);
+        } else if (arg == "-pgn" && hasValue) {
+            options.pgnFile = argv[++i];
+        } else if (arg == "-openings" && hasValue) {
+            loadOpenings(argv[++i], &options.openings);
+        } else if (arg == "-elo0" && hasValue) {
+            options.elo0 = atof(argv[++i]);
+        } else if (arg == "-elo1" && hasValue) {
+            options.elo1 = atof(argv[++i]);
+        } else if (arg == "-alpha" && hasValue) {
+            options.alpha = atof(argv[++i]);
+        } else if (arg == "-beta" && hasValue) {
+            options.beta = atof(argv[++i]);
+        } else if (arg[0] != '-' && engineCount < 2) {
+            options.engines[engineCount++] = arg;
+        } else {
+            engineCount = -1;
+            break;
+        }
+    }
+
+    if (engineCount != 2) {
+        std::cerr << "Usage: " << argv[0] << " [options] <engine A> "
+            "<engine B>\n";
+        return 1;
+    }
+
+    if (options.openings.empty()) {
+        options.openings.assign(std::begin(defaultOpenings),
+            std::end(defaultOpenings));
+    }
+
+    // Writing to an engine that died must not kill the runner
+    signal(SIGPIPE, SIG_IGN);
+
+    std::ofstream pgn(options.pgnFile);
+    DIE(!pgn, "Cannot open the PGN file");
+
+    std::mutex mutex;
+    MatchStats stats;
+    std::atomic<bool> decided(false);
+    double lower = log(options.beta / (1 - options.alpha));
+    double upper = log((1 - options.beta) / options.alpha);
+
+    ThreadPool pool(options.concurrency);
+    for (int i = 0; i < options.games; i++) {
+        pool.submit([&, i](unsigned int) {
+            if (decided) {
+                return;
+            }
+
+            // Engine A plays white in even games
+            int whiteIndex = i % 2;
+            const std::string& opening =
+                options.openings[(i / 2) % options.openings.size()];
+
+            GameResult game = playGame(options,
+                options.engines[whiteIndex], options.engines[1 - whiteIndex],
+                opening);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            double scoreA = whiteIndex == 0 ? game.score : 1 - game.score;
+            if (scoreA == 1) {
+                stats.wins++;
+            } else if (scoreA == 0) {
+                stats.losses++;
+            } else {
+                stats.draws++;
+            }
+
+            std::string white = engineName(options.engines[whiteIndex],
+                whiteIndex);
+            std::string black = engineName(options.engines[1 - whiteIndex],
+                1 - whiteIndex);
+            writePgn(pgn, i + 1, white, black, game);
+
+            std::cout << "Game " << i + 1 << ": " << white << " - " << black <<
+                " " << game.result << " {" << game.reason << "} | A: +" <<
+                stats.wins << " -" << stats.losses << " =" << stats.draws <<
+                std::endl;
+
+            double llr = stats.llr(options.elo0, options.elo1);
+            if (llr >= upper || llr <= lower) {
+                decided = true;
+            }
+        });
+    }
+    pool.wait();
+
+    printSummary(options, stats, std::cout);
+
+    return 0;
+}
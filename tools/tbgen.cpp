@@ -0,0 +1,495 @@
+/* Copyright 2021 DucaPowr Team */
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/board.h"
+#include "../src/constants.h"
+#include "../src/moveChecker.h"
+#include "../src/moveGen.h"
+#include "../src/tablebase.h"
+#include "../src/threadPool.h"
+
+#define DEBUG_FILE_NAME "tbgen.debug"
+
+std::ofstream Logger::debugFile(DEBUG_FILE_NAME);
+
+#define TBGEN_PART_MAGIC    0x50425444U  // "DTBP"
+// Positions given to a thread at a time
+#define TBGEN_CHUNK         (1 << 16)
+// Seconds between two checkpoints
+#define TBGEN_CHECKPOINT_SECONDS 60
+
+struct TbgenOptions {
+    std::vector<std::string> materials;
+    std::string dir = TABLEBASE_DIR;
+    // 0 for all hardware threads
+    unsigned int threads = 0;
+};
+
+// Header of a checkpoint file, followed by the values of every position
+struct TbgenCheckpoint {
+    uint32_t magic;
+    int32_t round;
+    int32_t maxDistance;
+    int32_t padding;
+    uint64_t size;
+};
+
+// The board and move generator of one thread
+struct TbgenWorker {
+    Board board;
+    Generator generator;
+    MoveChecker checker;
+    // Positions decided by this worker in the current round
+    uint64_t decided = 0;
+    // Longest distance of a position seen, see generate()
+    int maxDistance = 0;
+
+    TbgenWorker() : generator(board), checker(board) {
+        board.init();
+    }
+};
+
+// What the children of a position are worth to its side to move
+struct TbgenChildren {
+    int moves = 0;
+    // Plies of the fastest win, INT8_MAX + 1 if none
+    int bestWin = INT8_MAX + 1;
+    // Whether every child is a decided win of the opponent
+    bool allLost = true;
+    // Plies of the slowest of those wins
+    int slowestLoss = 0;
+};
+
+static int pieceValue(char letter) {
+    switch (letter) {
+        case 'Q': return 9;
+        case 'R': return 5;
+        case 'B': case 'N': return 3;
+        case 'P': return 1;
+        default: return 0;
+    }
+}
+
+/**
+ * The name a material is generated under: the stronger side first, so a
+ * table is never built for both colours. The empty string if the name is
+ * not a material.
+ */
+static std::string canonicalName(const std::string& material) {
+    TablebaseLayout layout;
+    if (!layout.parse(material)) {
+        return "";
+    }
+
+    size_t separator = layout.name.find('v');
+    std::string sides[2] = {layout.name.substr(0, separator),
+        layout.name.substr(separator + 1)};
+    int values[2] = {0, 0};
+    for (int side = 0; side < 2; side++) {
+        for (char letter : sides[side]) {
+            values[side] += pieceValue(letter);
+        }
+    }
+
+    // On equal values the side with the most pieces, then any fixed order
+    bool swap = values[1] > values[0] ||
+        (values[1] == values[0] && (sides[1].size() > sides[0].size() ||
+        (sides[1].size() == sides[0].size() && sides[1] > sides[0])));
+    return swap ? sides[1] + "v" + sides[0] : layout.name;
+}
+
+// Materials reached by a capture or a promotion
+static std::vector<std::string> dependencies(const std::string& name) {
+    std::vector<std::string> result;
+    size_t separator = name.find('v');
+
+    for (size_t i = 0; i < name.size(); i++) {
+        char letter = name[i];
+        if (letter == 'K' || i == separator) {
+            continue;
+        }
+
+        std::string captured = name.substr(0, i) + name.substr(i + 1);
+        if (captured != "KvK") {
+            result.push_back(canonicalName(captured));
+        }
+
+        if (letter == 'P') {
+            for (char promotion : std::string("QRBN")) {
+                std::string promoted = name;
+                promoted[i] = promotion;
+                result.push_back(canonicalName(promoted));
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * Value of a child position, for its own side to move. Children of another
+ * material are read from the tables already built.
+ */
+static int childValue(const CompactPosition& child,
+        const TablebaseLayout& layout, const std::atomic<int8_t> *values) {
+    if (child.checkCount[child.sideToMove] >= 3) {
+        return -1;
+    }
+
+    if (Tablebases::key(child.pieceBB) == layout.key) {
+        return values[layout.index(child)].load(std::memory_order_relaxed);
+    }
+
+    // Kings never give check
+    if (Tablebases::key(child.pieceBB) ==
+            ((1ULL << (4 * nWhiteKing)) | (1ULL << (4 * nBlackKing)))) {
+        return TB_DRAW;
+    }
+
+    int value;
+    DIE(!Tablebases::value(child, &value), "Missing endgame table");
+    return value;
+}
+
+/**
+ * Plays every legal move of a position.
+ * @return Returns false if the side not to move is in check, the position
+ * cannot happen.
+ */
+static bool scanChildren(TbgenWorker& w, const CompactPosition& pos,
+        const TablebaseLayout& layout, const std::atomic<int8_t> *values,
+        TbgenChildren *children) {
+    w.board.setPosition(pos);
+    if (w.checker.IamInCheck(w.generator.getAttackBB(w.board.sideToMove))) {
+        return false;
+    }
+
+    uint16_t moves[MAX_MOVES_AT_STEP];
+    uint16_t movesLen = 0;
+    w.generator.generateMoves(moves, &movesLen);
+    U64 attackBB = w.generator.getAttackBB(otherSide(w.board.sideToMove));
+
+    for (int i = 0; i < movesLen; i++) {
+        if (!w.checker.isLegal(moves[i], attackBB)) {
+            continue;
+        }
+
+        w.board.applyMove(moves[i]);
+        if (w.checker.IamInCheck(
+                w.generator.getAttackBB(w.board.sideToMove))) {
+            w.board.undoMove();
+            continue;
+        }
+
+        // The en passant right of a double push is dropped, the tables
+        // do not have it
+        CompactPosition child;
+        w.board.getPosition(&child);
+        if (w.checker.isCheck(
+                w.generator.getAttackBB(otherSide(w.board.sideToMove)))) {
+            child.checkCount[child.sideToMove]++;
+        }
+        w.board.undoMove();
+
+        int value = childValue(child, layout, values);
+        children->moves++;
+        if (value == TB_UNDECIDED || value == TB_DRAW) {
+            children->allLost = false;
+        } else if (value < 0) {
+            children->bestWin = std::min(children->bestWin, -value);
+            children->allLost = false;
+            w.maxDistance = std::max(w.maxDistance, -value - 1);
+        } else {
+            children->slowestLoss = std::max(children->slowestLoss, value);
+            w.maxDistance = std::max(w.maxDistance, value);
+        }
+    }
+    return true;
+}
+
+// Round 0: impossible positions, mates and stalemates
+static void initChunk(TbgenWorker& w, const TablebaseLayout& layout,
+        std::atomic<int8_t> *values, uint64_t first, uint64_t last) {
+    for (uint64_t index = first; index < last; index++) {
+        CompactPosition pos;
+        TbgenChildren children;
+        int8_t value = TB_UNDECIDED;
+
+        // Impossible positions are never read, they are stored as draws
+        if (!layout.decode(index, &pos) ||
+                !scanChildren(w, pos, layout, values, &children)) {
+            value = TB_DRAW;
+        } else if (children.moves == 0) {
+            w.board.setPosition(pos);
+            bool inCheck = w.checker.isCheck(
+                w.generator.getAttackBB(otherSide(w.board.sideToMove)));
+            value = inCheck ? -1 : TB_DRAW;
+        }
+
+        values[index].store(value, std::memory_order_relaxed);
+        w.decided += value != TB_UNDECIDED;
+    }
+}
+
+/**
+ * Round r: a position is won in r plies if a move reaches a position lost
+ * in r - 1, and lost in r plies if every move reaches a won position, the
+ * slowest won in r - 1. A position set by another thread in this round
+ * counts as a distance of r, so the result does not depend on the order.
+ */
+static void roundChunk(TbgenWorker& w, const TablebaseLayout& layout,
+        std::atomic<int8_t> *values, int round, uint64_t first,
+        uint64_t last) {
+    for (uint64_t index = first; index < last; index++) {
+        if (values[index].load(std::memory_order_relaxed) != TB_UNDECIDED) {
+            continue;
+        }
+
+        CompactPosition pos;
+        TbgenChildren children;
+        layout.decode(index, &pos);
+        scanChildren(w, pos, layout, values, &children);
+
+        if (children.bestWin == round) {
+            values[index].store(round, std::memory_order_relaxed);
+            w.decided++;
+        } else if (children.allLost && children.slowestLoss + 1 == round) {
+            values[index].store(-round - 1, std::memory_order_relaxed);
+            w.decided++;
+        }
+    }
+}
+
+static void markImpossible(TbgenWorker& w, const TablebaseLayout& layout,
+        std::atomic<int8_t> *values, uint64_t first, uint64_t last) {
+    for (uint64_t index = first; index < last; index++) {
+        CompactPosition pos;
+        bool impossible = !layout.decode(index, &pos);
+        if (!impossible) {
+            w.board.setPosition(pos);
+            impossible = w.checker.IamInCheck(
+                w.generator.getAttackBB(w.board.sideToMove));
+        }
+        if (impossible) {
+            values[index].store(TB_UNDECIDED, std::memory_order_relaxed);
+        }
+    }
+}
+
+static bool loadCheckpoint(const std::string& fileName,
+        const TablebaseLayout& layout, std::atomic<int8_t> *values,
+        TbgenCheckpoint *checkpoint) {
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in.read(reinterpret_cast<char *>(checkpoint), sizeof(*checkpoint)) ||
+            checkpoint->magic != TBGEN_PART_MAGIC ||
+            checkpoint->size != layout.size) {
+        return false;
+    }
+
+    // std::atomic<int8_t> has the layout of an int8_t
+    return static_cast<bool>(in.read(reinterpret_cast<char *>(values),
+        layout.size));
+}
+
+// Written next to the table and renamed, so a crash leaves the old one
+static void saveCheckpoint(const std::string& fileName,
+        const TablebaseLayout& layout, const std::atomic<int8_t> *values,
+        const TbgenCheckpoint& checkpoint) {
+    std::string tmpName = fileName + ".tmp";
+    std::ofstream out(tmpName, std::ios::binary);
+    DIE(!out, "Cannot open the checkpoint file");
+
+    out.write(reinterpret_cast<const char *>(&checkpoint),
+        sizeof(checkpoint));
+    out.write(reinterpret_cast<const char *>(values), layout.size);
+    out.close();
+    DIE(!out, "Cannot write the checkpoint file");
+    DIE(rename(tmpName.c_str(), fileName.c_str()) != 0,
+        "Cannot rename the checkpoint file");
+}
+
+/**
+ * Builds one table by retrograde analysis, round by round, on every
+ * thread of the pool. The rounds are saved to <name>.part from time to
+ * time, and a new run goes on from the last one saved.
+ */
+static void generate(const TablebaseLayout& layout, const std::string& dir,
+        ThreadPool& pool, std::vector<std::unique_ptr<TbgenWorker>>& workers) {
+    std::string tableName = dir + "/" + layout.name + TB_FILE_EXTENSION;
+    std::string partName = dir + "/" + layout.name + ".part";
+
+    std::unique_ptr<std::atomic<int8_t>[]> values(
+        new std::atomic<int8_t>[layout.size]);
+
+    TbgenCheckpoint checkpoint;
+    if (loadCheckpoint(partName, layout, values.get(), &checkpoint)) {
+        std::cout << layout.name << ": resuming after round " <<
+            checkpoint.round << std::endl;
+    } else {
+        for (uint64_t index = 0; index < layout.size; index++) {
+            values[index].store(TB_UNDECIDED, std::memory_order_relaxed);
+        }
+        checkpoint.magic = TBGEN_PART_MAGIC;
+        checkpoint.round = -1;
+        checkpoint.maxDistance = 0;
+        checkpoint.padding = 0;
+        checkpoint.size = layout.size;
+    }
+
+    auto lastSave = std::chrono::steady_clock::now();
+    uint64_t decided = 0;
+
+    for (int round = checkpoint.round + 1;; round++) {
+        for (auto& w : workers) {
+            w->decided = 0;
+        }
+
+        for (uint64_t first = 0; first < layout.size; first += TBGEN_CHUNK) {
+            uint64_t last = std::min<uint64_t>(layout.size,
+                first + TBGEN_CHUNK);
+            pool.submit([&, round, first, last](unsigned int index) {
+                TbgenWorker& w = *workers[index];
+                if (round == 0) {
+                    initChunk(w, layout, values.get(), first, last);
+                } else {
+                    roundChunk(w, layout, values.get(), round, first, last);
+                }
+            });
+        }
+        pool.wait();
+
+        decided = 0;
+        for (auto& w : workers) {
+            decided += w->decided;
+            checkpoint.maxDistance = std::max(checkpoint.maxDistance,
+                w->maxDistance);
+        }
+        checkpoint.round = round;
+        std::cout << layout.name << ": round " << round << ", " << decided <<
+            " positions decided" << std::endl;
+
+        // A position can still be decided by a distance seen in a child
+        if (round > 0 && decided == 0 &&
+                round > checkpoint.maxDistance + 1) {
+            break;
+        }
+        DIE(round == -TB_UNDECIDED - 2, "Distance too long for a table");
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastSave >=
+                std::chrono::seconds(TBGEN_CHECKPOINT_SECONDS)) {
+            saveCheckpoint(partName, layout, values.get(), checkpoint);
+            lastSave = now;
+        }
+    }
+
+    // Nobody can force a result from the positions left
+    uint64_t draws = 0;
+    for (uint64_t index = 0; index < layout.size; index++) {
+        if (values[index].load(std::memory_order_relaxed) == TB_UNDECIDED) {
+            values[index].store(TB_DRAW, std::memory_order_relaxed);
+            draws++;
+        }
+    }
+
+    // The impossible positions, marked as undecided again, copy the value
+    // before them
+    for (uint64_t first = 0; first < layout.size; first += TBGEN_CHUNK) {
+        uint64_t last = std::min<uint64_t>(layout.size, first + TBGEN_CHUNK);
+        pool.submit([&, first, last](unsigned int index) {
+            markImpossible(*workers[index], layout, values.get(), first,
+                last);
+        });
+    }
+    pool.wait();
+    for (uint64_t index = 0; index < layout.size; index++) {
+        if (values[index].load(std::memory_order_relaxed) == TB_UNDECIDED) {
+            values[index].store(index == 0 ? TB_DRAW :
+                values[index - 1].load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+        }
+    }
+
+    // std::atomic<int8_t> has the layout of an int8_t
+    DIE(!Tablebases::write(tableName, layout,
+        reinterpret_cast<const int8_t *>(values.get())),
+        "Cannot write the table file");
+    unlink(partName.c_str());
+    DIE(!Tablebases::add(tableName), "Cannot map the new table");
+    std::cout << layout.name << ": " << draws << " draws, written to " <<
+        tableName << std::endl;
+}
+
+// Builds a table after the ones it depends on, unless it exists
+static void build(const std::string& name, const TbgenOptions& options,
+        ThreadPool& pool, std::vector<std::unique_ptr<TbgenWorker>>& workers) {
+    std::string tableName = options.dir + "/" + name + TB_FILE_EXTENSION;
+    if (access(tableName.c_str(), F_OK) == 0) {
+        return;
+    }
+
+    for (const std::string& dependency : dependencies(name)) {
+        build(dependency, options, pool, workers);
+    }
+
+    TablebaseLayout layout;
+    layout.parse(name);
+    generate(layout, options.dir, pool, workers);
+}
+
+/**
+ * Usage: tbgen [-d dir] [-threads N] <material> ...
+ * Builds the endgame tables of the materials (eg: KQvK, KRvKP) for the
+ * engine (see src/tablebase.h), and the smaller ones they need.
+ */
+int main(int argc, char **argv) {
+    TbgenOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "-d" && hasValue) {
+            options.dir = argv[++i];
+        } else if (arg == "-threads" && hasValue) {
+            options.threads = atoi(argv[++i]);
+        } else if (arg[0] != '-' && !canonicalName(arg).empty()) {
+            options.materials.push_back(canonicalName(arg));
+        } else {
+            options.materials.clear();
+            break;
+        }
+    }
+
+    if (options.materials.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [-d " << TABLEBASE_DIR <<
+            "] [-threads N] <material> ...\n";
+        return 1;
+    }
+
+    // The new tables are read through the existing ones
+    Tablebases::open(options.dir);
+
+    ThreadPool pool(options.threads);
+    std::vector<std::unique_ptr<TbgenWorker>> workers;
+    for (unsigned int i = 0; i < pool.size(); i++) {
+        workers.emplace_back(new TbgenWorker());
+    }
+
+    for (const std::string& name : options.materials) {
+        build(name, options, pool, workers);
+    }
+
+    Tablebases::close();
+    return 0;
+}
@@ -0,0 +1,287 @@
+/* Copyright 2021 DucaPowr Team */
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/batchEval.h"
+#include "../src/board.h"
+#include "../src/evalParams.h"
+
+#define DEBUG_FILE_NAME "tune.debug"
+
+std::ofstream Logger::debugFile(DEBUG_FILE_NAME);
+
+static std::vector<CompactPosition> positions;
+// Game results from white's point of view: 1, 0.5 or 0
+static std::vector<double> results;
+static std::vector<int> scores;
+static unsigned int threads;
+
+/**
+ * Reads the game result from a labelled line. Both the "1-0" / "0-1" /
+ * "1/2-1/2" and the "[1.0]" / "[0.5]" / "[0.0]" conventions are accepted.
+ * @return Returns false if the line has no result.
+ */
+static bool parseResult(const std::string& line, double *result) {
+    if (line.find("1/2-1/2") != std::string::npos ||
+            line.find("[0.5]") != std::string::npos) {
+        *result = 0.5;
+    } else if (line.find("1-0") != std::string::npos ||
+            line.find("[1.0]") != std::string::npos) {
+        *result = 1;
+    } else if (line.find("0-1") != std::string::npos ||
+            line.find("[0.0]") != std::string::npos) {
+        *result = 0;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Loads a file with one labelled position per line: a FEN followed by the
+ * result of the game it was taken from.
+ */
+static void loadPositions(const char *fileName) {
+    std::ifstream f(fileName);
+    DIE(!f, "Cannot open the positions file");
+
+    Board board;
+    board.init();
+
+    std::string line;
+    size_t skipped = 0;
+    while (std::getline(f, line)) {
+        double result;
+        CompactPosition pos;
+
+        if (!parseResult(line, &result) || !board.setFromFEN(line)) {
+            skipped++;
+            continue;
+        }
+
+        board.getPosition(&pos);
+        positions.push_back(pos);
+        results.push_back(result);
+    }
+
+    std::cout << "Loaded " << positions.size() << " positions, skipped " <<
+        skipped << " lines\n";
+}
+
+// Drops the positions where the game is already decided by the rules
+static void removeFinishedGames(void) {
+    scores.resize(positions.size());
+    evalBatch(positions.data(), positions.size(), scores.data(), threads);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < positions.size(); i++) {
+        if (scores[i] == INT_MIN || scores[i] == INT_MAX) {
+            continue;
+        }
+        positions[kept] = positions[i];
+        results[kept] = results[i];
+        kept++;
+    }
+
+    positions.resize(kept);
+    results.resize(kept);
+    scores.resize(kept);
+}
+
+/**
+ * Mean squared error between the game results and the eval scores mapped
+ * to a winning probability by a sigmoid.
+ */
+static double meanSquaredError(double k) {
+    evalBatch(positions.data(), positions.size(), scores.data(), threads);
+
+    double error = 0;
+    for (size_t i = 0; i < positions.size(); i++) {
+        // Board::eval() scores from the side to move's point of view
+        double score = positions[i].sideToMove == whiteSide ?
+            scores[i] : -scores[i];
+        double sigmoid = 1 / (1 + pow(10, -k * score / 400));
+        error += (results[i] - sigmoid) * (results[i] - sigmoid);
+    }
+
+    return error / positions.size();
+}
+
+// Finds the sigmoid scaling constant that fits the current eval best
+static double fitScalingConstant(void) {
+    double bestK = 1, bestError = meanSquaredError(bestK);
+
+    for (double step = 0.5; step > 0.001; step /= 2) {
+        for (int dir = -1; dir <= 1; dir += 2) {
+            double k = bestK + dir * step;
+            if (k <= 0) {
+                continue;
+            }
+            double error = meanSquaredError(k);
+            if (error < bestError) {
+                bestK = k;
+                bestError = error;
+            }
+        }
+    }
+
+    return bestK;
+}
+
+// Prints a piece-square table in the layout of evalConstants.h
+static void writeTable(FILE *f, const char *name, const int *table) {
+    fprintf(f, "const int %s[64] = {\n", name);
+    for (int rank = 0; rank < 8; rank++) {
+        fprintf(f, "   ");
+        for (int file = 0; file < 8; file++) {
+            fprintf(f, " %4d,", table[rank * 8 + file]);
+        }
+        fprintf(f, "\n");
+    }
+    fprintf(f, "};\n\n");
+}
+
+static void writeHeader(const char *fileName, double k, double error) {
+    FILE *f = fopen(fileName, "w");
+    DIE(f == NULL, "Cannot open the output header");
+
+    const EvalParams& p = evalParams;
+    const char *tableNames[6] = {"pawn", "bishop", "knight", "rook",
+        "queen", "king"};
+
+    fprintf(f, "/* Copyright 2021 DucaPowr Team */\n#pragma once\n\n");
+    fprintf(f, "/**\n * Default eval weights. They are copied into the "
+        "runtime parameter block\n * (evalParams.h) at startup. This file "
+        "can be regenerated by tools/tune.\n *\n * Generated by tools/tune:"
+        " %zu positions, K = %.4f, error = %.8f\n */\n\n",
+        positions.size(), k, error);
+
+    fprintf(f, "enum PieceConstants : int {\n");
+    fprintf(f, "    PawnValueMg = %d, PawnValueEg = %d,\n",
+        p.pawnValueMg, p.pawnValueEg);
+    fprintf(f, "    KnightValueMg = %d, KnightValueEg = %d,\n",
+        p.knightValueMg, p.knightValueEg);
+    fprintf(f, "    BishopValueMg = %d, BishopValueEg = %d,\n",
+        p.bishopValueMg, p.bishopValueEg);
+    fprintf(f, "    RookValueMg = %d, RookValueEg = %d,\n",
+        p.rookValueMg, p.rookValueEg);
+    fprintf(f, "    QueenValueMg = %d, QueenValueEg = %d\n};\n\n",
+        p.queenValueMg, p.queenValueEg);
+
+    fprintf(f, "const int CheckCountValue = %d;\n\n", p.checkCountValue);
+
+    fprintf(f, "const int KingFriendsValueMg = %d;\n", p.kingFriendsValueMg);
+    fprintf(f, "const int KingFriendsValueEg = %d;\n\n",
+        p.kingFriendsValueEg);
+
+    fprintf(f, "// King danger, per square from which the enemy can give "
+        "check\n");
+    fprintf(f, "const int KnightCheckValue = %d;\n", p.knightCheckValue);
+    fprintf(f, "const int BishopCheckValue = %d;\n", p.bishopCheckValue);
+    fprintf(f, "const int RookCheckValue = %d;\n", p.rookCheckValue);
+    fprintf(f, "const int QueenCheckValue = %d;\n", p.queenCheckValue);
+    fprintf(f, "// King danger, per attacked square around the king\n");
+    fprintf(f, "const int KingZoneAttackValue = %d;\n\n",
+        p.kingZoneAttackValue);
+
+    for (int i = 0; i < 6; i++) {
+        std::string name = std::string("mg_") + tableNames[i] + "_table";
+        writeTable(f, name.c_str(), p.mgTables[i]);
+        name = std::string("eg_") + tableNames[i] + "_table";
+        writeTable(f, name.c_str(), p.egTables[i]);
+    }
+
+    fclose(f);
+}
+
+// Pawns never stand on the first and last ranks
+static bool isTunable(size_t index) {
+    int *params = reinterpret_cast<int *>(&evalParams);
+    int *square = params + index;
+
+    for (int *table : {evalParams.mgTables[0], evalParams.egTables[0]}) {
+        if ((square >= table && square < table + 8) ||
+                (square >= table + 56 && square < table + 64)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Usage: ./tune <positions file> [output header] [threads] [max passes]
+ *
+ * Texel's tuning method: a local search that moves one parameter at a time
+ * by +-step and keeps the change when the error drops. The step halves
+ * whenever a whole pass brings no improvement.
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <positions file> "
+            "[output header] [threads] [max passes]\n";
+        return 1;
+    }
+
+    const char *output = argc > 2 ? argv[2] : "evalConstants.h";
+    threads = argc > 3 ? atoi(argv[3]) : 0;
+    int maxPasses = argc > 4 ? atoi(argv[4]) : 1000;
+
+    loadPositions(argv[1]);
+    removeFinishedGames();
+    DIE(positions.empty(), "No positions to tune on");
+
+    double k = fitScalingConstant();
+    double bestError = meanSquaredError(k);
+    std::cout << "K = " << k << ", initial error = " << bestError << '\n';
+
+    int *params = reinterpret_cast<int *>(&evalParams);
+    int step = 8;
+
+    for (int pass = 1; pass <= maxPasses && step > 0; pass++) {
+        bool improved = false;
+
+        for (size_t i = 0; i < EVAL_PARAMS_COUNT; i++) {
+            if (!isTunable(i)) {
+                continue;
+            }
+
+            params[i] += step;
+            double error = meanSquaredError(k);
+            if (error < bestError) {
+                bestError = error;
+                improved = true;
+                continue;
+            }
+
+            params[i] -= 2 * step;
+            error = meanSquaredError(k);
+            if (error < bestError) {
+                bestError = error;
+                improved = true;
+                continue;
+            }
+
+            params[i] += step;
+        }
+
+        std::cout << "pass " << pass << " step " << step << " error " <<
+            bestError << '\n';
+
+        // Save after every pass, so a long run can be stopped at any time
+        writeHeader(output, k, bestError);
+
+        if (!improved) {
+            step /= 2;
+        }
+    }
+
+    return 0;
+}